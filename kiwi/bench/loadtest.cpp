@@ -0,0 +1,451 @@
+/**
+ * A load generator for the Kiwi web server.
+ *
+ * Starts a Kiwi web script on loopback, drives one of its routes from a
+ * number of connections, and reports the throughput and a latency
+ * histogram.
+ *
+ * In closed-loop mode each connection sends its next request as soon as the
+ * previous one completes. In open-loop mode requests are sent on a fixed
+ * schedule, and latency is measured from the time a request was due, so a
+ * server that falls behind is charged for the queueing it causes.
+ *
+ * usage: kiwi-loadtest [options]
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN64
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "web/httplib.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string kiwi = "bin/kiwi";
+  std::string script = "bench/web/server.🥝";
+  std::string host = "127.0.0.1";
+  int port = 18080;
+  std::string method = "GET";
+  std::string path = "/hello";
+  std::string body;
+  int connections = 8;
+  double rate = 0;
+  double duration = 5;
+  double warmup = 1;
+  bool keepAlive = true;
+  bool spawn = true;
+  bool json = false;
+};
+
+/// @brief Counts latencies in log-linear buckets.
+///
+/// Each power of two is split into 32 buckets, so a recorded value is within
+/// about 3% of its true value. Values are in microseconds.
+class LatencyHistogram {
+ public:
+  static constexpr int SubBuckets = 32;
+  static constexpr int Magnitudes = 40;
+
+  void record(int64_t micros) {
+    ++counts[getBucket(std::max<int64_t>(micros, 0))];
+    ++total;
+    sum += micros;
+    minimum = std::min(minimum, micros);
+    maximum = std::max(maximum, micros);
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+      counts[i] += other.counts[i];
+    }
+
+    total += other.total;
+    sum += other.sum;
+    minimum = std::min(minimum, other.minimum);
+    maximum = std::max(maximum, other.maximum);
+  }
+
+  int64_t getCount() const { return total; }
+  int64_t getMin() const { return total > 0 ? minimum : 0; }
+  int64_t getMax() const { return maximum; }
+  double getMean() const { return total > 0 ? sum / total : 0; }
+
+  /// @brief Gets the upper bound of the bucket holding a percentile.
+  int64_t getPercentile(double percentile) const {
+    auto rank = static_cast<int64_t>(std::ceil(percentile / 100 * total));
+    int64_t seen = 0;
+
+    for (size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen >= rank && counts[i] > 0) {
+        return std::min(getUpperBound(static_cast<int>(i)), maximum);
+      }
+    }
+
+    return maximum;
+  }
+
+  /// @brief Gets the counts grouped by power of two, for display.
+  std::vector<std::pair<int64_t, int64_t>> getRanges() const {
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+
+    for (int magnitude = 0; magnitude < Magnitudes; ++magnitude) {
+      int64_t count = 0;
+      for (int sub = 0; sub < SubBuckets; ++sub) {
+        count += counts[magnitude * SubBuckets + sub];
+      }
+
+      if (count > 0) {
+        ranges.emplace_back(int64_t{1} << magnitude, count);
+      }
+    }
+
+    return ranges;
+  }
+
+ private:
+  std::array<int64_t, Magnitudes * SubBuckets> counts{};
+  int64_t total = 0;
+  double sum = 0;
+  int64_t minimum = INT64_MAX;
+  int64_t maximum = 0;
+
+  // Values below SubBuckets are exact; above, a bucket is 1/32 of a power
+  // of two wide.
+  static int getBucket(int64_t micros) {
+    if (micros < SubBuckets) {
+      return static_cast<int>(micros);
+    }
+
+    int magnitude = 63 - __builtin_clzll(static_cast<uint64_t>(micros));
+    int shift = magnitude - 5;
+    int sub = static_cast<int>((micros >> shift) - SubBuckets);
+    int bucket = magnitude * SubBuckets + sub;
+    return std::min(bucket, Magnitudes * SubBuckets - 1);
+  }
+
+  static int64_t getUpperBound(int bucket) {
+    if (bucket < SubBuckets) {
+      return bucket;
+    }
+
+    int magnitude = bucket / SubBuckets;
+    int sub = bucket % SubBuckets;
+    int shift = magnitude - 5;
+    return ((int64_t{SubBuckets} + sub + 1) << shift) - 1;
+  }
+};
+
+struct WorkerResult {
+  LatencyHistogram histogram;
+  int64_t errors = 0;
+};
+
+int64_t toMicros(Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+httplib::Result sendRequest(httplib::Client& client, const Options& options) {
+  if (options.method == "POST") {
+    return client.Post(options.path, options.body, "text/plain");
+  }
+
+  return client.Get(options.path);
+}
+
+void runWorker(int id, const Options& options, Clock::time_point start,
+               WorkerResult& result) {
+  httplib::Client client(options.host, options.port);
+  client.set_keep_alive(options.keepAlive);
+  client.set_tcp_nodelay(true);
+
+  auto measureFrom = start + std::chrono::duration_cast<Clock::duration>(
+                                 std::chrono::duration<double>(options.warmup));
+  auto end = measureFrom + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double>(options.duration));
+
+  // In open-loop mode the connections share the rate and are staggered so
+  // their requests interleave.
+  Clock::duration interval{0};
+  auto due = start;
+  if (options.rate > 0) {
+    interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.connections / options.rate));
+    due += interval * id / options.connections;
+  }
+
+  while (true) {
+    if (options.rate > 0) {
+      std::this_thread::sleep_until(due);
+    } else {
+      due = Clock::now();
+    }
+
+    if (due >= end) {
+      break;
+    }
+
+    auto response = sendRequest(client, options);
+    auto latency = Clock::now() - due;
+
+    if (due >= measureFrom) {
+      if (!response || response->status != 200) {
+        ++result.errors;
+      } else {
+        result.histogram.record(toMicros(latency));
+      }
+    }
+
+    due += interval;
+  }
+}
+
+bool waitForServer(const Options& options, double timeoutSeconds) {
+  auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                     std::chrono::duration<double>(
+                                         timeoutSeconds));
+  httplib::Client client(options.host, options.port);
+  client.set_connection_timeout(0, 100000);
+
+  while (Clock::now() < deadline) {
+    if (client.Get("/")) {
+      return true;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  return false;
+}
+
+#ifndef _WIN64
+pid_t startServer(const Options& options) {
+  auto portArg = "-port=" + std::to_string(options.port);
+  pid_t pid = fork();
+
+  if (pid == 0) {
+    execl(options.kiwi.c_str(), options.kiwi.c_str(), options.script.c_str(),
+          portArg.c_str(), static_cast<char*>(nullptr));
+    std::perror("execl");
+    std::_Exit(127);
+  }
+
+  return pid;
+}
+
+void stopServer(pid_t pid) {
+  if (pid > 0) {
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+  }
+}
+#endif
+
+std::string formatMillis(int64_t micros) {
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(3) << micros / 1000.0;
+  return ss.str();
+}
+
+void printReport(const Options& options, const LatencyHistogram& histogram,
+                 int64_t errors) {
+  auto requests = histogram.getCount();
+  auto throughput = requests / options.duration;
+  auto mode = options.rate > 0 ? "open" : "closed";
+
+  if (options.json) {
+    std::cout << "{\"method\": \"" << options.method << "\", \"path\": \""
+              << options.path << "\", \"mode\": \"" << mode
+              << "\", \"connections\": " << options.connections
+              << ", \"keep_alive\": " << (options.keepAlive ? "true" : "false")
+              << ", \"requests\": " << requests << ", \"errors\": " << errors
+              << ", \"requests_per_second\": " << std::fixed
+              << std::setprecision(1) << throughput
+              << ", \"latency_ms\": {\"min\": "
+              << formatMillis(histogram.getMin())
+              << ", \"mean\": " << formatMillis(histogram.getMean())
+              << ", \"p50\": " << formatMillis(histogram.getPercentile(50))
+              << ", \"p90\": " << formatMillis(histogram.getPercentile(90))
+              << ", \"p99\": " << formatMillis(histogram.getPercentile(99))
+              << ", \"p999\": " << formatMillis(histogram.getPercentile(99.9))
+              << ", \"max\": " << formatMillis(histogram.getMax()) << "}}"
+              << std::endl;
+    return;
+  }
+
+  std::cout << options.method << " " << options.path << ", " << mode
+            << "-loop, " << options.connections << " connection(s), keep-alive "
+            << (options.keepAlive ? "on" : "off") << std::endl;
+  std::cout << requests << " requests in " << options.duration << "s, "
+            << errors << " error(s), " << std::fixed << std::setprecision(1)
+            << throughput << " requests/sec" << std::endl
+            << std::endl;
+
+  std::cout << "Latency (ms)" << std::endl;
+  std::vector<std::pair<std::string, int64_t>> stats = {
+      {"min", histogram.getMin()},
+      {"mean", static_cast<int64_t>(histogram.getMean())},
+      {"p50", histogram.getPercentile(50)},
+      {"p90", histogram.getPercentile(90)},
+      {"p99", histogram.getPercentile(99)},
+      {"p999", histogram.getPercentile(99.9)},
+      {"max", histogram.getMax()},
+  };
+
+  for (const auto& stat : stats) {
+    std::cout << "  " << std::left << std::setw(6) << stat.first << std::right
+              << std::setw(12) << formatMillis(stat.second) << std::endl;
+  }
+
+  std::cout << std::endl << "Histogram (ms)" << std::endl;
+  auto ranges = histogram.getRanges();
+  int64_t largest = 1;
+  for (const auto& range : ranges) {
+    largest = std::max(largest, range.second);
+  }
+
+  for (const auto& range : ranges) {
+    auto label = "< " + formatMillis(range.first * 2);
+    auto bar = std::string(static_cast<size_t>(40 * range.second / largest),
+                           '#');
+    std::cout << "  " << std::left << std::setw(12) << label << std::right
+              << std::setw(10) << range.second << "  " << bar << std::endl;
+  }
+}
+
+void printUsage() {
+  std::cerr
+      << "usage: kiwi-loadtest [options]\n\n"
+         "  --kiwi <path>         The Kiwi executable. Defaults to bin/kiwi.\n"
+         "  --script <path>       The web script to start. Defaults to "
+         "bench/web/server.🥝.\n"
+         "  --attach              Use a server that is already running.\n"
+         "  --host <host>         The server host. Defaults to 127.0.0.1.\n"
+         "  --port <port>         The server port. Defaults to 18080.\n"
+         "  --method <GET|POST>   The request method. Defaults to GET.\n"
+         "  --path <path>         The request path. Defaults to /hello.\n"
+         "  --body <text>         The request body for POST.\n"
+         "  --connections <n>     The number of connections. Defaults to 8.\n"
+         "  --rate <n>            Requests per second, in open-loop mode.\n"
+         "                        Defaults to 0, for closed-loop mode.\n"
+         "  --duration <seconds>  The measured duration. Defaults to 5.\n"
+         "  --warmup <seconds>    The unmeasured warmup. Defaults to 1.\n"
+         "  --no-keep-alive       Open a connection for each request.\n"
+         "  --json                Print the report as a line of JSON.\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (arg == "--attach") {
+      options.spawn = false;
+    } else if (arg == "--no-keep-alive") {
+      options.keepAlive = false;
+    } else if (arg == "--json") {
+      options.json = true;
+    } else if (!hasValue) {
+      return false;
+    } else if (arg == "--kiwi") {
+      options.kiwi = argv[++i];
+    } else if (arg == "--script") {
+      options.script = argv[++i];
+    } else if (arg == "--host") {
+      options.host = argv[++i];
+    } else if (arg == "--port") {
+      options.port = std::stoi(argv[++i]);
+    } else if (arg == "--method") {
+      options.method = argv[++i];
+    } else if (arg == "--path") {
+      options.path = argv[++i];
+    } else if (arg == "--body") {
+      options.body = argv[++i];
+    } else if (arg == "--connections") {
+      options.connections = std::max(1, std::stoi(argv[++i]));
+    } else if (arg == "--rate") {
+      options.rate = std::max(0.0, std::stod(argv[++i]));
+    } else if (arg == "--duration") {
+      options.duration = std::max(0.1, std::stod(argv[++i]));
+    } else if (arg == "--warmup") {
+      options.warmup = std::max(0.0, std::stod(argv[++i]));
+    } else {
+      return false;
+    }
+  }
+
+  return options.method == "GET" || options.method == "POST";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+
+#ifdef _WIN64
+  if (options.spawn) {
+    std::cerr << "Start the server first and use --attach." << std::endl;
+    return 1;
+  }
+#else
+  pid_t server = options.spawn ? startServer(options) : 0;
+#endif
+
+  if (!waitForServer(options, 10)) {
+    std::cerr << "The server at " << options.host << ":" << options.port
+              << " did not start." << std::endl;
+#ifndef _WIN64
+    stopServer(server);
+#endif
+    return 1;
+  }
+
+  std::vector<WorkerResult> results(options.connections);
+  std::vector<std::thread> workers;
+  auto start = Clock::now();
+
+  for (int i = 0; i < options.connections; ++i) {
+    workers.emplace_back(runWorker, i, std::cref(options), start,
+                         std::ref(results[i]));
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+#ifndef _WIN64
+  stopServer(server);
+#endif
+
+  LatencyHistogram histogram;
+  int64_t errors = 0;
+  for (const auto& result : results) {
+    histogram.merge(result.histogram);
+    errors += result.errors;
+  }
+
+  printReport(options, histogram, errors);
+  return errors > 0 ? 1 : 0;
+}
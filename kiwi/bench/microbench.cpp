@@ -0,0 +1,372 @@
+/**
+ * Microbenchmarks for interpreter internals.
+ *
+ * Each benchmark runs on a generated input. Its calls are grouped into
+ * repetitions that last at least a minimum time, and the median throughput
+ * of the repetitions is reported. The process is pinned to one CPU so that
+ * migrations between cores do not add noise.
+ *
+ * usage: kiwi-microbench [--filter <text>] [--repetitions <n>]
+ *                        [--min-time <ms>] [--json]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN64
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "tracing/error.h"
+#include "tracing/runtimestats.h"
+#include "math/functions.h"
+#include "parsing/tokens.h"
+#include "util/file.h"
+#include "util/string.h"
+#include "typing/serializer.h"
+#include "typing/value.h"
+#include "globals.h"
+#include "parsing/lexer.h"
+#include "parsing/parser.h"
+
+std::unordered_map<std::string, std::string> kiwiArgs;
+FrameStack callStack;
+std::stack<std::string> packageStack;
+bool SILENCE = false;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// @brief Keeps a result alive so the optimizer cannot drop the work.
+volatile uint64_t sink = 0;
+
+struct Benchmark {
+  std::string name;
+  std::string unit;
+  // The amount of work done by one call, in units.
+  double work;
+  std::function<void()> run;
+};
+
+struct Result {
+  std::string name;
+  std::string unit;
+  double median;
+  double spread;
+  int64_t calls;
+};
+
+struct Options {
+  std::string filter;
+  int repetitions = 15;
+  int64_t minTimeNanos = 20000000;
+  bool json = false;
+};
+
+/// @brief Pins the process to the CPU it is running on.
+bool pinToCpu() {
+#ifdef _WIN64
+  return SetThreadAffinityMask(GetCurrentThread(),
+                               1ULL << GetCurrentProcessorNumber()) != 0;
+#elif defined(__linux__)
+  int cpu = sched_getcpu();
+  if (cpu < 0) {
+    return false;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+int64_t elapsedNanos(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                              start)
+      .count();
+}
+
+/// @brief Finds the number of calls that fills the minimum repetition time.
+int64_t calibrate(const Benchmark& benchmark, int64_t minTimeNanos) {
+  int64_t calls = 1;
+
+  while (true) {
+    auto start = Clock::now();
+    for (int64_t i = 0; i < calls; ++i) {
+      benchmark.run();
+    }
+
+    auto nanos = elapsedNanos(start);
+    if (nanos >= minTimeNanos) {
+      return calls;
+    }
+
+    auto scale = nanos > 0 ? (minTimeNanos * 1.2) / nanos : 10.0;
+    calls = std::max(calls + 1,
+                     static_cast<int64_t>(calls * std::min(scale, 10.0)));
+  }
+}
+
+double getMedian(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  auto n = values.size();
+  return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+Result measure(const Benchmark& benchmark, const Options& options) {
+  auto calls = calibrate(benchmark, options.minTimeNanos);
+  std::vector<double> throughputs;
+
+  for (int rep = 0; rep < options.repetitions; ++rep) {
+    auto start = Clock::now();
+    for (int64_t i = 0; i < calls; ++i) {
+      benchmark.run();
+    }
+
+    auto seconds = elapsedNanos(start) / 1e9;
+    throughputs.push_back(benchmark.work * calls / seconds);
+  }
+
+  // The spread is the median absolute deviation, relative to the median.
+  auto median = getMedian(throughputs);
+  std::vector<double> deviations;
+  for (auto value : throughputs) {
+    deviations.push_back(std::abs(value - median));
+  }
+
+  return {benchmark.name, benchmark.unit, median,
+          getMedian(deviations) * 100 / median, calls};
+}
+
+/// @brief Generates a script that exercises most of the grammar.
+std::string generateSource(int functions) {
+  std::ostringstream ss;
+
+  for (int i = 0; i < functions; ++i) {
+    ss << "# Generated function " << i << ".\n"
+       << "fn compute_" << i << "(items, limit = " << i << ")\n"
+       << "  total = 0\n"
+       << "  label = \"item-${limit}\"\n"
+       << "  lookup = { \"name\": label, \"size\": items.size(), \"ratio\": "
+       << i << ".5 }\n"
+       << "  for item, index in items do\n"
+       << "    if item % 3 == 0 && index < limit\n"
+       << "      total += item * 2 - (index / 4)\n"
+       << "    elsif item > 10\n"
+       << "      total -= lookup.size ** 2\n"
+       << "    else\n"
+       << "      next\n"
+       << "    end\n"
+       << "  end\n"
+       << "  values = [1, 2, 3, total, limit].map(with (n) do n + 1 end)\n"
+       << "  return total > 0 ? values.sum() : label.size()\n"
+       << "end\n\n";
+  }
+
+  return ss.str();
+}
+
+k_value generateValue(int depth, int width) {
+  if (depth == 0) {
+    return static_cast<k_string>("leaf-" + std::to_string(width));
+  }
+
+  auto list = std::make_shared<List>();
+  auto hash = std::make_shared<Hash>();
+
+  for (int i = 0; i < width; ++i) {
+    list->elements.emplace_back(static_cast<k_int>(i * depth));
+    list->elements.emplace_back(i * 0.25);
+    hash->add("key" + std::to_string(i), generateValue(depth - 1, width));
+  }
+
+  hash->add("values", list);
+  hash->add("flag", depth % 2 == 0);
+  return hash;
+}
+
+int64_t countValues(const k_value& value) {
+  int64_t count = 1;
+
+  if (std::holds_alternative<k_list>(value)) {
+    for (const auto& element : std::get<k_list>(value)->elements) {
+      count += countValues(element);
+    }
+  } else if (std::holds_alternative<k_hash>(value)) {
+    for (const auto& pair : std::get<k_hash>(value)->kvp) {
+      count += countValues(pair.second);
+    }
+  }
+
+  return count;
+}
+
+std::vector<Benchmark> createBenchmarks() {
+  std::vector<Benchmark> benchmarks;
+
+  // The source is registered once; the lexer benchmark reuses the file id so
+  // the registry does not grow on every call.
+  auto source = std::make_shared<std::string>(generateSource(200));
+  auto fileId =
+      FileRegistry::getInstance().registerFile("<microbench>", *source);
+
+  benchmarks.push_back({"lexer", "MB/s", source->size() / 1e6, [=]() {
+                          Lexer lexer(fileId, *source);
+                          sink = sink + lexer.getAllTokens().size();
+                        }});
+
+  auto tokens = std::make_shared<std::vector<Token>>(
+      Lexer(fileId, *source).getAllTokens());
+  auto before = RuntimeStats::get(RuntimeCounter::ParsedNodes);
+  {
+    auto stream = std::make_shared<TokenStream>(*tokens);
+    Parser parser;
+    parser.parseTokenStream(stream, true);
+  }
+  auto nodes = RuntimeStats::get(RuntimeCounter::ParsedNodes) - before;
+
+  benchmarks.push_back({"parser", "Mnodes/s", nodes / 1e6, [=]() {
+                          auto stream = std::make_shared<TokenStream>(*tokens);
+                          Parser parser;
+                          auto ast = parser.parseTokenStream(stream, true);
+                          sink = sink + static_cast<uint64_t>(ast->type);
+                        }});
+
+  struct BinaryCase {
+    std::string name;
+    KName op;
+    k_value left;
+    k_value right;
+  };
+
+  std::vector<BinaryCase> binaryCases = {
+      {"math int add", KName::Ops_Add, static_cast<k_int>(40),
+       static_cast<k_int>(2)},
+      {"math double multiply", KName::Ops_Multiply, 1.5, 2.25},
+      {"math int/double divide", KName::Ops_Divide, static_cast<k_int>(7),
+       2.0},
+      {"math int compare", KName::Ops_LessThan, static_cast<k_int>(3),
+       static_cast<k_int>(4)},
+      {"math string concat", KName::Ops_Add, static_cast<k_string>("kiwi"),
+       static_cast<k_string>("-fruit")},
+  };
+
+  // Each call performs a batch of operations, so the loop and the std::function
+  // call are amortized.
+  const int batch = 1000;
+  for (const auto& binaryCase : binaryCases) {
+    benchmarks.push_back({binaryCase.name, "Mops/s", batch / 1e6, [=]() {
+                            auto token = Token::createEmpty();
+                            for (int i = 0; i < batch; ++i) {
+                              auto result = MathImpl.do_binary_op(
+                                  token, binaryCase.op, binaryCase.left,
+                                  binaryCase.right);
+                              sink = sink + result.index();
+                            }
+                          }});
+  }
+
+  auto value = generateValue(3, 8);
+  auto serialized = Serializer::serialize(value);
+
+  benchmarks.push_back({"serializer", "MB/s", serialized.size() / 1e6, [=]() {
+                          sink = sink + Serializer::serialize(value).size();
+                        }});
+
+  benchmarks.push_back({"clone_value", "Mvalues/s", countValues(value) / 1e6,
+                        [=]() { sink = sink + clone_value(value).index(); }});
+
+  return benchmarks;
+}
+
+void printTable(const std::vector<Result>& results) {
+  std::cout << std::left << std::setw(26) << "Benchmark" << std::right
+            << std::setw(14) << "Throughput" << "  " << std::left
+            << std::setw(10) << "Unit" << std::right << std::setw(10)
+            << "Spread" << std::setw(12) << "Calls" << std::endl;
+
+  for (const auto& result : results) {
+    std::cout << std::left << std::setw(26) << result.name << std::right
+              << std::setw(14) << std::fixed << std::setprecision(3)
+              << result.median << "  " << std::left << std::setw(10)
+              << result.unit << std::right << std::setw(9)
+              << std::setprecision(2) << result.spread << "%" << std::setw(12)
+              << result.calls << std::endl;
+  }
+}
+
+void printJson(const std::vector<Result>& results) {
+  for (const auto& result : results) {
+    std::cout << "{\"benchmark\": \"" << result.name << "\", \"unit\": \""
+              << result.unit << "\", \"throughput\": " << result.median
+              << ", \"spread_percent\": " << result.spread
+              << ", \"calls\": " << result.calls << "}" << std::endl;
+  }
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (arg == "--json") {
+      options.json = true;
+    } else if (arg == "--filter" && hasValue) {
+      options.filter = argv[++i];
+    } else if (arg == "--repetitions" && hasValue) {
+      options.repetitions = std::max(1, std::stoi(argv[++i]));
+    } else if (arg == "--min-time" && hasValue) {
+      options.minTimeNanos = std::max(1LL, std::stoll(argv[++i])) * 1000000;
+    } else {
+      std::cerr << "usage: kiwi-microbench [--filter <text>] "
+                   "[--repetitions <n>] [--min-time <ms>] [--json]"
+                << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    return 1;
+  }
+
+  if (!pinToCpu()) {
+    std::cerr << "Could not pin to a CPU; timings may be noisy." << std::endl;
+  }
+
+  std::vector<Result> results;
+  for (const auto& benchmark : createBenchmarks()) {
+    if (benchmark.name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+
+    results.push_back(measure(benchmark, options));
+  }
+
+  if (options.json) {
+    printJson(results);
+  } else {
+    printTable(results);
+  }
+
+  return 0;
+}
@@ -13,6 +13,7 @@
 #include "builtins/fileio_handler.h"
 #include "builtins/logging_handler.h"
 #include "builtins/math_handler.h"
+#include "builtins/matrix_handler.h"
 #include "builtins/sys_handler.h"
 #include "builtins/time_handler.h"
 #include "builtins/http_handler.h"
@@ -31,6 +32,8 @@ class BuiltinDispatch {
       return TimeBuiltinHandler::execute(term, builtin, args);
     } else if (MathBuiltins.is_builtin(builtin)) {
       return MathBuiltinHandler::execute(term, builtin, args);
+    } else if (MatrixBuiltins.is_builtin(builtin)) {
+      return MatrixBuiltinHandler::execute(term, builtin, args);
     } else if (EnvBuiltins.is_builtin(builtin)) {
       return EnvBuiltinHandler::execute(term, builtin, args);
     } else if (EncoderBuiltins.is_builtin(builtin)) {
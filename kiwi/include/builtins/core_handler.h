@@ -253,7 +253,9 @@ class CoreBuiltinHandler {
     auto s = get_string(term, value);
     std::vector<k_value> tokens;
 
-    Lexer lex("", s);
+    // Lex under the caller's file id, so the string is not registered as a
+    // new source file on every call.
+    Lexer lex(term.getFile(), s);
 
     auto ts = lex.getAllTokens();
     tokens.reserve(ts.size());
@@ -299,6 +301,12 @@ class CoreBuiltinHandler {
       case 8:  // k_null
         return false;
 
+      case 10:  // k_matrix
+        return !std::get<k_matrix>(value)->cells.empty();
+
+      case 11:  // k_bigint
+        return true;
+
       default:
         return false;
     }
@@ -646,6 +654,8 @@ class CoreBuiltinHandler {
       }
     } else if (std::holds_alternative<k_int>(value)) {
       return static_cast<double>(std::get<k_int>(value));
+    } else if (std::holds_alternative<k_bigint>(value)) {
+      return std::get<k_bigint>(value)->toDouble();
     } else {
       throw ConversionError(term,
                             "Cannot convert non-numeric value to a double.");
@@ -665,8 +675,12 @@ class CoreBuiltinHandler {
           std::from_chars(stringValue.data(),
                           stringValue.data() + stringValue.size(), intValue);
 
+      BigInt bigValue;
       if (ec == std::errc()) {
         return static_cast<k_int>(intValue);
+      } else if (ec == std::errc::result_out_of_range &&
+                 BigInt::parse(stringValue, bigValue)) {
+        return make_integer(std::move(bigValue));
       } else {
         throw ConversionError(
             term, "Cannot convert non-numeric value to an integer: `" +
@@ -674,6 +688,8 @@ class CoreBuiltinHandler {
       }
     } else if (std::holds_alternative<double>(value)) {
       return static_cast<k_int>(std::get<double>(value));
+    } else if (std::holds_alternative<k_bigint>(value)) {
+      return value;
     } else {
       throw ConversionError(term,
                             "Cannot convert non-numeric value to an integer.");
@@ -1083,6 +1099,12 @@ class CoreBuiltinHandler {
       case 8:  // k_null
         return typeName == TypeNames.None;
 
+      case 10:  // k_matrix
+        return typeName == TypeNames.Matrix;
+
+      case 11:  // k_bigint
+        return typeName == TypeNames.Integer;
+
       default:
         return false;
     }
@@ -1,13 +1,19 @@
 #ifndef KIWI_BUILTINS_HTTPHANDLER_H
 #define KIWI_BUILTINS_HTTPHANDLER_H
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 #include "math/functions.h"
 #include "parsing/builtins.h"
 #include "parsing/tokens.h"
+#include "tracing/chrometrace.h"
 #include "typing/serializer.h"
 #include "typing/value.h"
+#include "util/string.h"
 
 class HttpBuiltinHandler {
  public:
@@ -25,6 +31,9 @@ class HttpBuiltinHandler {
       case KName::Builtin_WebClient_Put:
         return executePatchPostPut(term, args, builtin);
 
+      case KName::Builtin_WebClient_Batch:
+        return executeBatch(term, args);
+
       default:
         break;
     }
@@ -33,6 +42,183 @@ class HttpBuiltinHandler {
   }
 
  private:
+  struct BatchRequest {
+    k_string method;
+    k_string url;
+    k_string path;
+    k_string body;
+    k_string contentType;
+    httplib::Headers headers;
+    std::unique_ptr<httplib::Client> client;
+  };
+
+  static k_value executeBatch(const Token& term,
+                              const std::vector<k_value>& args) {
+    if (args.size() != 3) {
+      throw BuiltinUnexpectedArgumentError(term, HttpBuiltins.Batch);
+    }
+
+    if (!std::holds_alternative<k_list>(args.at(0))) {
+      throw InvalidOperationError(term,
+                                  "Expected a list of request hashes.");
+    }
+
+    auto concurrency = get_integer(term, args.at(1));
+    auto defaultTimeout = get_integer(term, args.at(2));
+
+    if (concurrency < 1) {
+      throw InvalidOperationError(term,
+                                  "Expected a positive concurrency limit.");
+    }
+
+    // Everything touching Kiwi values happens on this thread; the workers
+    // only ever see plain request data.
+    const auto& elements = std::get<k_list>(args.at(0))->elements;
+    std::vector<BatchRequest> requests;
+    requests.reserve(elements.size());
+
+    for (const auto& element : elements) {
+      requests.emplace_back(getBatchRequest(term, element, defaultTimeout));
+    }
+
+    TraceSpan traceSpan("http.client", "batch");
+    std::vector<httplib::Result> results(requests.size());
+    std::vector<k_string> errors(requests.size());
+    std::atomic<size_t> next{0};
+
+    // An exception must never escape a worker thread, so a request that
+    // throws is reported through its own response hash instead.
+    auto worker = [&]() {
+      for (size_t i = next++; i < requests.size(); i = next++) {
+        try {
+          results[i] = sendBatchRequest(requests[i]);
+        } catch (const std::exception& e) {
+          errors[i] = e.what();
+        } catch (...) {
+          errors[i] = "Unknown error";
+        }
+      }
+    };
+
+    auto workerCount =
+        std::min(static_cast<size_t>(concurrency), requests.size());
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount);
+
+    for (size_t i = 0; i < workerCount; ++i) {
+      workers.emplace_back(worker);
+    }
+
+    for (auto& thread : workers) {
+      thread.join();
+    }
+
+    auto responses = std::make_shared<List>();
+    responses->elements.reserve(results.size());
+
+    for (size_t i = 0; i < results.size(); ++i) {
+      responses->elements.emplace_back(
+          errors[i].empty() ? getResponseHash(results[i])
+                            : getErrorResponseHash("Request failed: " +
+                                                   errors[i]));
+    }
+
+    return responses;
+  }
+
+  static BatchRequest getBatchRequest(const Token& term, const k_value& value,
+                                      const k_int& defaultTimeout) {
+    if (!std::holds_alternative<k_hash>(value)) {
+      throw InvalidOperationError(term, "Expected a hash type for request.");
+    }
+
+    auto hash = std::get<k_hash>(value);
+    BatchRequest request;
+
+    if (!hash->hasKey("url")) {
+      throw InvalidOperationError(term, "Expected a `url` key in request.");
+    }
+
+    request.url = get_string(term, hash->get("url"));
+    request.method =
+        hash->hasKey("method")
+            ? String::toUppercase(get_string(term, hash->get("method")))
+            : "GET";
+    request.path =
+        hash->hasKey("path") ? get_string(term, hash->get("path")) : "/";
+    request.contentType = hash->hasKey("content_type")
+                              ? get_string(term, hash->get("content_type"))
+                              : "text/plain";
+    request.body =
+        hash->hasKey("body") ? Serializer::serialize(hash->get("body")) : "";
+    auto timeout = hash->hasKey("timeout")
+                       ? get_integer(term, hash->get("timeout"))
+                       : defaultTimeout;
+
+    if (hash->hasKey("headers")) {
+      auto headers = hash->get("headers");
+      if (!std::holds_alternative<k_hash>(headers)) {
+        throw InvalidOperationError(term, "Expected a hash type for headers.");
+      }
+      request.headers = getHeaders(std::get<k_hash>(headers));
+    }
+
+    static const std::unordered_set<k_string> methods = {
+        "DELETE", "GET", "HEAD", "OPTIONS", "PATCH", "POST", "PUT"};
+    if (methods.find(request.method) == methods.end()) {
+      throw InvalidOperationError(
+          term, "Unsupported HTTP method `" + request.method + "`.");
+    }
+
+    // The client parses the URL, and rejects an unsupported scheme by
+    // throwing, so it is built here rather than on a worker thread.
+    try {
+      request.client = std::make_unique<httplib::Client>(request.url);
+    } catch (const std::exception& e) {
+      throw InvalidOperationError(
+          term, "Invalid URL `" + request.url + "`: " + e.what());
+    }
+
+    if (!request.client->is_valid()) {
+      throw InvalidOperationError(term, "Invalid URL `" + request.url + "`.");
+    }
+
+    if (timeout > 0) {
+      auto duration = std::chrono::milliseconds(timeout);
+      request.client->set_connection_timeout(duration);
+      request.client->set_read_timeout(duration);
+      request.client->set_write_timeout(duration);
+    }
+
+    return request;
+  }
+
+  static httplib::Result sendBatchRequest(const BatchRequest& request) {
+    TraceSpan traceSpan("http.client",
+                        request.method + " " + request.url + request.path);
+    auto& cli = *request.client;
+
+    const auto& method = request.method;
+    if (method == "GET") {
+      return cli.Get(request.path, request.headers);
+    } else if (method == "DELETE") {
+      return cli.Delete(request.path, request.headers);
+    } else if (method == "HEAD") {
+      return cli.Head(request.path, request.headers);
+    } else if (method == "OPTIONS") {
+      return cli.Options(request.path, request.headers);
+    } else if (method == "PATCH") {
+      return cli.Patch(request.path, request.headers, request.body,
+                       request.contentType);
+    } else if (method == "PUT") {
+      return cli.Put(request.path, request.headers, request.body,
+                     request.contentType);
+    }
+
+    return cli.Post(request.path, request.headers, request.body,
+                    request.contentType);
+  }
+
   static k_value executeDeleteGetHeadOptions(const Token& term,
                                              const std::vector<k_value>& args,
                                              const KName& builtin) {
@@ -173,13 +359,19 @@ class HttpBuiltinHandler {
 
       resHash->add("headers", headersHash);
     } else {
-      resHash->add("status", static_cast<k_int>(0));
-      resHash->add("body", "Request failed or no response received");
-      resHash->add("headers", std::make_shared<Hash>());
+      return getErrorResponseHash("Request failed or no response received");
     }
 
     return resHash;
   }
+
+  static k_value getErrorResponseHash(const k_string& message) {
+    auto resHash = std::make_shared<Hash>();
+    resHash->add("status", static_cast<k_int>(0));
+    resHash->add("body", message);
+    resHash->add("headers", std::make_shared<Hash>());
+    return resHash;
+  }
 };
 
 #endif
\ No newline at end of file
@@ -1,17 +1,28 @@
 #ifndef KIWI_BUILTINS_MATHHANDLER_H
 #define KIWI_BUILTINS_MATHHANDLER_H
 
+#include <cmath>
+#include <new>
+#include <optional>
+#include <stdexcept>
 #include <vector>
 #include "parsing/builtins.h"
 #include "parsing/tokens.h"
 #include "math/functions.h"
 #include "math/primes.h"
+#include "math/stats.h"
 #include "typing/value.h"
 
 class MathBuiltinHandler {
  public:
   static k_value execute(const Token& term, const KName& builtin,
                          const std::vector<k_value>& args) {
+    if (hasListArgument(args)) {
+      if (auto result = executeOverLists(term, builtin, args)) {
+        return *result;
+      }
+    }
+
     switch (builtin) {
       case KName::Builtin_Math_Sin:
         return executeSin(term, args);
@@ -151,9 +162,42 @@ class MathBuiltinHandler {
       case KName::Builtin_Math_NthPrime:
         return executeNthPrime(term, args);
 
+      case KName::Builtin_Math_CountPrimes:
+        return executeCountPrimes(term, args);
+
       case KName::Builtin_Math_Divisors:
         return executeDivisors(term, args);
 
+      case KName::Builtin_Math_Mean:
+        return executeMean(term, args);
+
+      case KName::Builtin_Math_Variance:
+        return executeVariance(term, args);
+
+      case KName::Builtin_Math_StdDev:
+        return executeStdDev(term, args);
+
+      case KName::Builtin_Math_Median:
+        return executeMedian(term, args);
+
+      case KName::Builtin_Math_Quantile:
+        return executeQuantile(term, args);
+
+      case KName::Builtin_Math_Histogram:
+        return executeHistogram(term, args);
+
+      case KName::Builtin_Math_CumSum:
+        return executeCumSum(term, args);
+
+      case KName::Builtin_Math_ArgMin:
+        return executeArgMin(term, args);
+
+      case KName::Builtin_Math_ArgMax:
+        return executeArgMax(term, args);
+
+      case KName::Builtin_Math_PowMod:
+        return executePowMod(term, args);
+
       default:
         break;
     }
@@ -162,6 +206,253 @@ class MathBuiltinHandler {
   }
 
  private:
+  static bool hasListArgument(const std::vector<k_value>& args) {
+    for (const auto& arg : args) {
+      if (std::holds_alternative<k_list>(arg)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// @brief Applies an element-wise builtin to lists of numbers, giving each
+  /// element the result the builtin gives for that number alone. A scalar
+  /// argument to a two-argument builtin is paired with every element.
+  /// Returns nothing for builtins that are not element-wise.
+  static std::optional<k_value> executeOverLists(
+      const Token& term, const KName& builtin,
+      const std::vector<k_value>& args) {
+    switch (builtin) {
+      case KName::Builtin_Math_Sin:
+        return mapUnary(term, args, MathBuiltins.Sin,
+                        [](double x) { return std::sin(x); });
+      case KName::Builtin_Math_Cos:
+        return mapUnary(term, args, MathBuiltins.Cos,
+                        [](double x) { return std::cos(x); });
+      case KName::Builtin_Math_Tan:
+        return mapUnary(term, args, MathBuiltins.Tan,
+                        [](double x) { return std::tan(x); });
+      case KName::Builtin_Math_Asin:
+        return mapUnary(term, args, MathBuiltins.Asin,
+                        [](double x) { return std::asin(x); });
+      case KName::Builtin_Math_Acos:
+        return mapUnary(term, args, MathBuiltins.Acos,
+                        [](double x) { return std::acos(x); });
+      case KName::Builtin_Math_Atan:
+        return mapUnary(term, args, MathBuiltins.Atan,
+                        [](double x) { return std::atan(x); });
+      case KName::Builtin_Math_Sinh:
+        return mapUnary(term, args, MathBuiltins.Sinh,
+                        [](double x) { return std::sinh(x); });
+      case KName::Builtin_Math_Cosh:
+        return mapUnary(term, args, MathBuiltins.Cosh,
+                        [](double x) { return std::cosh(x); });
+      case KName::Builtin_Math_Tanh:
+        return mapUnary(term, args, MathBuiltins.Tanh,
+                        [](double x) { return std::tanh(x); });
+      case KName::Builtin_Math_Log:
+        return mapUnary(term, args, MathBuiltins.Log,
+                        [](double x) { return std::log(x); });
+      case KName::Builtin_Math_Log2:
+        return mapUnary(term, args, MathBuiltins.Log2,
+                        [](double x) { return std::log2(x); });
+      case KName::Builtin_Math_Log10:
+        return mapUnary(term, args, MathBuiltins.Log10,
+                        [](double x) { return std::log10(x); });
+      case KName::Builtin_Math_Log1P:
+        return mapUnary(term, args, MathBuiltins.Log1P,
+                        [](double x) { return std::log1p(x); });
+      case KName::Builtin_Math_Sqrt:
+        return mapUnary(term, args, MathBuiltins.Sqrt,
+                        [](double x) { return std::sqrt(x); });
+      case KName::Builtin_Math_Cbrt:
+        return mapUnary(term, args, MathBuiltins.Cbrt,
+                        [](double x) { return std::cbrt(x); });
+      case KName::Builtin_Math_Floor:
+        return mapUnary(term, args, MathBuiltins.Floor,
+                        [](double x) { return std::floor(x); });
+      case KName::Builtin_Math_Ceil:
+        return mapUnary(term, args, MathBuiltins.Ceil,
+                        [](double x) { return std::ceil(x); });
+      case KName::Builtin_Math_Round:
+        return mapUnary(term, args, MathBuiltins.Round,
+                        [](double x) { return std::round(x); });
+      case KName::Builtin_Math_Trunc:
+        return mapUnary(term, args, MathBuiltins.Trunc,
+                        [](double x) { return std::trunc(x); });
+      case KName::Builtin_Math_Exp:
+        return mapUnary(term, args, MathBuiltins.Exp,
+                        [](double x) { return std::exp(x); });
+      case KName::Builtin_Math_ExpM1:
+        return mapUnary(term, args, MathBuiltins.ExpM1,
+                        [](double x) { return std::expm1(x); });
+      case KName::Builtin_Math_Erf:
+        return mapUnary(term, args, MathBuiltins.Erf,
+                        [](double x) { return std::erf(x); });
+      case KName::Builtin_Math_ErfC:
+        return mapUnary(term, args, MathBuiltins.ErfC,
+                        [](double x) { return std::erfc(x); });
+      case KName::Builtin_Math_LGamma:
+        return mapUnary(term, args, MathBuiltins.LGamma,
+                        [](double x) { return std::lgamma(x); });
+      case KName::Builtin_Math_TGamma:
+        return mapUnary(term, args, MathBuiltins.TGamma,
+                        [](double x) { return std::tgamma(x); });
+      case KName::Builtin_Math_IsFinite:
+        return mapUnary(term, args, MathBuiltins.IsFinite,
+                        [](double x) { return std::isfinite(x); });
+      case KName::Builtin_Math_IsInf:
+        return mapUnary(term, args, MathBuiltins.IsInf,
+                        [](double x) { return std::isinf(x); });
+      case KName::Builtin_Math_IsNaN:
+        return mapUnary(term, args, MathBuiltins.IsNaN,
+                        [](double x) { return std::isnan(x); });
+      case KName::Builtin_Math_IsNormal:
+        return mapUnary(term, args, MathBuiltins.IsNormal,
+                        [](double x) { return std::isnormal(x); });
+      case KName::Builtin_Math_Abs:
+        return mapAbs(term, args);
+      case KName::Builtin_Math_Atan2:
+        return mapBinary(term, args, MathBuiltins.Atan2,
+                         [](double y, double x) { return std::atan2(y, x); });
+      case KName::Builtin_Math_Fmod:
+        return mapBinary(term, args, MathBuiltins.Fmod,
+                         [](double x, double y) { return std::fmod(x, y); });
+      case KName::Builtin_Math_Hypot:
+        return mapBinary(term, args, MathBuiltins.Hypot,
+                         [](double x, double y) { return std::hypot(x, y); });
+      case KName::Builtin_Math_Remainder:
+        return mapBinary(
+            term, args, MathBuiltins.Remainder,
+            [](double x, double y) { return std::remainder(x, y); });
+      case KName::Builtin_Math_FMax:
+        return mapBinary(term, args, MathBuiltins.FMax,
+                         [](double x, double y) { return std::fmax(x, y); });
+      case KName::Builtin_Math_FMin:
+        return mapBinary(term, args, MathBuiltins.FMin,
+                         [](double x, double y) { return std::fmin(x, y); });
+      case KName::Builtin_Math_FDim:
+        return mapBinary(term, args, MathBuiltins.FDim,
+                         [](double x, double y) { return std::fdim(x, y); });
+      case KName::Builtin_Math_CopySign:
+        return mapBinary(
+            term, args, MathBuiltins.CopySign,
+            [](double x, double y) { return std::copysign(x, y); });
+      case KName::Builtin_Math_NextAfter:
+        return mapBinary(
+            term, args, MathBuiltins.NextAfter,
+            [](double x, double y) { return std::nextafter(x, y); });
+      case KName::Builtin_Math_Pow:
+        return mapBinary(term, args, MathBuiltins.Pow,
+                         [](double x, double y) { return std::pow(x, y); });
+      default:
+        return std::nullopt;
+    }
+  }
+
+  /// @brief Copies the numbers of a list into a contiguous buffer.
+  static std::vector<double> unpackNumbers(const Token& term,
+                                           const k_value& value) {
+    const auto& elements = std::get<k_list>(value)->elements;
+    std::vector<double> numbers(elements.size());
+
+    for (size_t i = 0; i < elements.size(); ++i) {
+      numbers[i] = MathImpl.get_double(term, elements[i]);
+    }
+
+    return numbers;
+  }
+
+  template <typename T>
+  static k_value packResults(const std::vector<T>& results) {
+    auto list = std::make_shared<List>();
+    auto& elements = list->elements;
+    elements.reserve(results.size());
+
+    for (const auto& result : results) {
+      elements.emplace_back(result);
+    }
+
+    return list;
+  }
+
+  /// @brief Runs a kernel over a buffer in one tight loop, which the
+  /// compiler can vectorize when the kernel allows it.
+  template <typename Kernel>
+  static k_value mapUnary(const Token& term, const std::vector<k_value>& args,
+                          const k_string& name, Kernel kernel) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, name);
+    }
+
+    auto numbers = unpackNumbers(term, args.at(0));
+    std::vector<decltype(kernel(0.0))> results(numbers.size());
+
+    for (size_t i = 0; i < numbers.size(); ++i) {
+      results[i] = kernel(numbers[i]);
+    }
+
+    return packResults(results);
+  }
+
+  template <typename Kernel>
+  static k_value mapBinary(const Token& term, const std::vector<k_value>& args,
+                           const k_string& name, Kernel kernel) {
+    if (args.size() != 2) {
+      throw BuiltinUnexpectedArgumentError(term, name);
+    }
+
+    const auto& valueX = args.at(0);
+    const auto& valueY = args.at(1);
+    bool listX = std::holds_alternative<k_list>(valueX);
+    bool listY = std::holds_alternative<k_list>(valueY);
+
+    std::vector<double> numbersX;
+    std::vector<double> numbersY;
+
+    if (listX && listY) {
+      numbersX = unpackNumbers(term, valueX);
+      numbersY = unpackNumbers(term, valueY);
+      if (numbersX.size() != numbersY.size()) {
+        throw InvalidOperationError(
+            term, "Expected lists of the same size for builtin `" + name +
+                      "`.");
+      }
+    } else if (listX) {
+      numbersX = unpackNumbers(term, valueX);
+      numbersY.assign(numbersX.size(), MathImpl.get_double(term, valueY));
+    } else {
+      numbersY = unpackNumbers(term, valueY);
+      numbersX.assign(numbersY.size(), MathImpl.get_double(term, valueX));
+    }
+
+    std::vector<double> results(numbersX.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+      results[i] = kernel(numbersX[i], numbersY[i]);
+    }
+
+    return packResults(results);
+  }
+
+  /// @brief Takes the absolute value of each element, keeping integers as
+  /// integers.
+  static k_value mapAbs(const Token& term, const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.Abs);
+    }
+
+    const auto& elements = std::get<k_list>(args.at(0))->elements;
+    auto list = std::make_shared<List>();
+    auto& results = list->elements;
+    results.reserve(elements.size());
+
+    for (const auto& element : elements) {
+      results.emplace_back(MathImpl.__abs__(term, element));
+    }
+
+    return list;
+  }
+
   static k_value executeSin(const Token& term,
                             const std::vector<k_value>& args) {
     if (args.size() != 1) {
@@ -566,16 +857,45 @@ class MathBuiltinHandler {
                                       MathBuiltins.ListPrimes + "`.");
     }
 
-    auto primes = PrimeGenerator::listPrimes(std::get<k_int>(args.at(0)));
-    auto list = std::make_shared<List>();
-    auto& elements = list->elements;
-    elements.reserve(primes.size());
+    // A limit past what memory can hold fails here rather than aborting.
+    try {
+      auto primes = PrimeGenerator::listPrimes(std::get<k_int>(args.at(0)));
+      auto list = std::make_shared<List>();
+      auto& elements = list->elements;
+      elements.reserve(primes.size());
+
+      for (const auto& prime : primes) {
+        elements.emplace_back(static_cast<k_int>(prime));
+      }
+
+      return list;
+    } catch (const std::bad_alloc&) {
+      throw tooManyPrimes(term);
+    } catch (const std::length_error&) {
+      throw tooManyPrimes(term);
+    }
+  }
+
+  static InvalidOperationError tooManyPrimes(const Token& term) {
+    return InvalidOperationError(
+        term, "Too many primes to list for builtin `" +
+                  MathBuiltins.ListPrimes + "`. Use `" +
+                  MathBuiltins.CountPrimes + "` to count them instead.");
+  }
 
-    for (const auto& prime : primes) {
-      elements.emplace_back(static_cast<k_int>(prime));
+  static k_value executeCountPrimes(const Token& term,
+                                    const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.CountPrimes);
     }
 
-    return list;
+    if (!std::holds_alternative<k_int>(args.at(0))) {
+      throw ConversionError(term, "Expected an integer argument for builtin `" +
+                                      MathBuiltins.CountPrimes + "`.");
+    }
+
+    return static_cast<k_int>(
+        PrimeGenerator::countPrimes(std::get<k_int>(args.at(0))));
   }
 
   static k_value executeNthPrime(const Token& term,
@@ -589,9 +909,14 @@ class MathBuiltinHandler {
                                       MathBuiltins.NthPrime + "`.");
     }
 
-    auto nthPrime = PrimeGenerator::nthPrime(std::get<k_int>(args.at(0)));
+    auto n = std::get<k_int>(args.at(0));
+    if (n < 1) {
+      throw InvalidOperationError(
+          term, "Expected a positive integer argument for builtin `" +
+                    MathBuiltins.NthPrime + "`.");
+    }
 
-    return static_cast<k_int>(nthPrime);
+    return static_cast<k_int>(PrimeGenerator::nthPrime(n));
   }
 
   static k_value executeRandom(const Token& term,
@@ -625,6 +950,231 @@ class MathBuiltinHandler {
 
     return list;
   }
+
+  /// @brief Unpacks the list of numbers a statistics builtin summarizes.
+  static std::vector<double> unpackSample(const Token& term,
+                                          const k_value& value,
+                                          const k_string& name) {
+    if (!std::holds_alternative<k_list>(value)) {
+      throw ConversionError(
+          term, "Expected a list argument for builtin `" + name + "`.");
+    }
+
+    auto numbers = unpackNumbers(term, value);
+    if (numbers.empty()) {
+      throw InvalidOperationError(
+          term, "Expected a non-empty list for builtin `" + name + "`.");
+    }
+
+    return numbers;
+  }
+
+  /// @brief Unpacks a sample for a builtin that orders or bins its values,
+  /// which NaN and infinities do not fit.
+  static std::vector<double> unpackFiniteSample(const Token& term,
+                                                const k_value& value,
+                                                const k_string& name) {
+    auto numbers = unpackSample(term, value, name);
+    for (auto number : numbers) {
+      if (!std::isfinite(number)) {
+        throw InvalidOperationError(
+            term, "Expected finite numbers for builtin `" + name + "`.");
+      }
+    }
+
+    return numbers;
+  }
+
+  static k_value executeMean(const Token& term,
+                             const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.Mean);
+    }
+
+    return Stats::mean(unpackSample(term, args.at(0), MathBuiltins.Mean));
+  }
+
+  static k_value executeVariance(const Token& term,
+                                 const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.Variance);
+    }
+
+    return Stats::variance(
+        unpackSample(term, args.at(0), MathBuiltins.Variance));
+  }
+
+  static k_value executeStdDev(const Token& term,
+                               const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.StdDev);
+    }
+
+    return std::sqrt(
+        Stats::variance(unpackSample(term, args.at(0), MathBuiltins.StdDev)));
+  }
+
+  static k_value executeMedian(const Token& term,
+                               const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.Median);
+    }
+
+    auto numbers = unpackFiniteSample(term, args.at(0), MathBuiltins.Median);
+    return Stats::quantile(numbers, 0.5);
+  }
+
+  static k_value executeQuantile(const Token& term,
+                                 const std::vector<k_value>& args) {
+    if (args.size() != 2) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.Quantile);
+    }
+
+    auto numbers =
+        unpackFiniteSample(term, args.at(0), MathBuiltins.Quantile);
+    auto getQ = [&](const k_value& value) {
+      auto q = MathImpl.get_double(term, value);
+      if (!(q >= 0 && q <= 1)) {
+        throw InvalidOperationError(
+            term, "Expected a quantile between 0 and 1 for builtin `" +
+                      MathBuiltins.Quantile + "`.");
+      }
+      return q;
+    };
+
+    const auto& qs = args.at(1);
+    if (!std::holds_alternative<k_list>(qs)) {
+      return Stats::quantile(numbers, getQ(qs));
+    }
+
+    // Each selection leaves the buffer partly ordered, which makes the
+    // selections after it cheaper.
+    const auto& elements = std::get<k_list>(qs)->elements;
+    std::vector<double> results;
+    results.reserve(elements.size());
+
+    for (const auto& q : elements) {
+      results.push_back(Stats::quantile(numbers, getQ(q)));
+    }
+
+    return packResults(results);
+  }
+
+  static k_value executeHistogram(const Token& term,
+                                  const std::vector<k_value>& args) {
+    if (args.size() != 2) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.Histogram);
+    }
+
+    auto numbers =
+        unpackFiniteSample(term, args.at(0), MathBuiltins.Histogram);
+    const auto& binsValue = args.at(1);
+    if (!std::holds_alternative<k_int>(binsValue) ||
+        std::get<k_int>(binsValue) < 1) {
+      throw InvalidOperationError(
+          term, "Expected a positive integer bin count for builtin `" +
+                    MathBuiltins.Histogram + "`.");
+    }
+
+    auto bins = static_cast<size_t>(std::get<k_int>(binsValue));
+    auto low = numbers[Stats::argExtreme(numbers, false)];
+    auto high = numbers[Stats::argExtreme(numbers, true)];
+    auto counts = Stats::histogram(numbers, bins, low, high);
+
+    std::vector<k_int> countResults(counts.begin(), counts.end());
+    auto edges = Stats::binEdges(bins, low, high);
+
+    auto hash = std::make_shared<Hash>();
+    hash->add("counts", packResults(countResults));
+    hash->add("edges", packResults(edges));
+    return hash;
+  }
+
+  /// @brief Returns the running totals of a list, as integers when every
+  /// element is an integer.
+  static k_value executeCumSum(const Token& term,
+                               const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.CumSum);
+    }
+
+    const auto& value = args.at(0);
+    if (!std::holds_alternative<k_list>(value)) {
+      throw ConversionError(term, "Expected a list argument for builtin `" +
+                                      MathBuiltins.CumSum + "`.");
+    }
+
+    const auto& elements = std::get<k_list>(value)->elements;
+    bool integers = true;
+    for (const auto& element : elements) {
+      if (!is_integer(element)) {
+        integers = false;
+        break;
+      }
+    }
+
+    if (integers) {
+      std::vector<k_value> totals;
+      totals.reserve(elements.size());
+      k_int total = 0;
+      bool promoted = false;
+      BigInt bigTotal;
+
+      for (const auto& element : elements) {
+        k_int next = 0;
+        if (!promoted && std::holds_alternative<k_int>(element) &&
+            !Bits::addOverflow(total, std::get<k_int>(element), next)) {
+          total = next;
+          totals.emplace_back(total);
+          continue;
+        }
+
+        // Once the total leaves 64 bits, it carries on as a BigInt.
+        if (!promoted) {
+          bigTotal = BigInt(total);
+          promoted = true;
+        }
+        bigTotal = bigTotal + get_bigint(element);
+        totals.emplace_back(make_integer(BigInt(bigTotal)));
+      }
+      return packResults(totals);
+    }
+
+    auto totals = unpackNumbers(term, value);
+    for (size_t i = 1; i < totals.size(); ++i) {
+      totals[i] += totals[i - 1];
+    }
+    return packResults(totals);
+  }
+
+  static k_value executeArgMin(const Token& term,
+                               const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.ArgMin);
+    }
+
+    auto numbers = unpackSample(term, args.at(0), MathBuiltins.ArgMin);
+    return static_cast<k_int>(Stats::argExtreme(numbers, false));
+  }
+
+  static k_value executeArgMax(const Token& term,
+                               const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.ArgMax);
+    }
+
+    auto numbers = unpackSample(term, args.at(0), MathBuiltins.ArgMax);
+    return static_cast<k_int>(Stats::argExtreme(numbers, true));
+  }
+
+  static k_value executePowMod(const Token& term,
+                               const std::vector<k_value>& args) {
+    if (args.size() != 3) {
+      throw BuiltinUnexpectedArgumentError(term, MathBuiltins.PowMod);
+    }
+
+    return MathImpl.__powmod__(term, args.at(0), args.at(1), args.at(2));
+  }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,398 @@
+#ifndef KIWI_BUILTINS_MATRIXHANDLER_H
+#define KIWI_BUILTINS_MATRIXHANDLER_H
+
+#include <new>
+#include <vector>
+#include "math/functions.h"
+#include "math/matrix.h"
+#include "parsing/builtins.h"
+#include "parsing/tokens.h"
+#include "typing/value.h"
+
+class MatrixBuiltinHandler {
+ public:
+  static k_value execute(const Token& term, const KName& builtin,
+                         const std::vector<k_value>& args) {
+    switch (builtin) {
+      case KName::Builtin_Matrix_New:
+        return executeNew(term, args);
+
+      case KName::Builtin_Matrix_FromList:
+        return executeFromList(term, args);
+
+      case KName::Builtin_Matrix_ToList:
+        return executeToList(term, args);
+
+      case KName::Builtin_Matrix_Shape:
+        return executeShape(term, args);
+
+      case KName::Builtin_Matrix_Get:
+        return executeGet(term, args);
+
+      case KName::Builtin_Matrix_Set:
+        return executeSet(term, args);
+
+      case KName::Builtin_Matrix_Slice:
+        return executeSlice(term, args);
+
+      case KName::Builtin_Matrix_Add:
+        return executeZip(term, args, MatrixBuiltins.Add,
+                          [](double x, double y) { return x + y; });
+
+      case KName::Builtin_Matrix_Subtract:
+        return executeZip(term, args, MatrixBuiltins.Subtract,
+                          [](double x, double y) { return x - y; });
+
+      case KName::Builtin_Matrix_Multiply:
+        return executeZip(term, args, MatrixBuiltins.Multiply,
+                          [](double x, double y) { return x * y; });
+
+      case KName::Builtin_Matrix_Divide:
+        return executeZip(term, args, MatrixBuiltins.Divide,
+                          [](double x, double y) { return x / y; });
+
+      case KName::Builtin_Matrix_Equal:
+        return executeZip(
+            term, args, MatrixBuiltins.Equal,
+            [](double x, double y) { return x == y ? 1.0 : 0.0; });
+
+      case KName::Builtin_Matrix_Sum:
+        return executeReduce(term, args, MatrixBuiltins.Sum,
+                             MatrixKernels::Reduction::Sum);
+
+      case KName::Builtin_Matrix_Min:
+        return executeReduce(term, args, MatrixBuiltins.Min,
+                             MatrixKernels::Reduction::Min);
+
+      case KName::Builtin_Matrix_Max:
+        return executeReduce(term, args, MatrixBuiltins.Max,
+                             MatrixKernels::Reduction::Max);
+
+      case KName::Builtin_Matrix_Transpose:
+        return executeTranspose(term, args);
+
+      case KName::Builtin_Matrix_MatMul:
+        return executeMatMul(term, args);
+
+      case KName::Builtin_Matrix_Convolve:
+        return executeConvolve(term, args);
+
+      default:
+        break;
+    }
+
+    throw UnknownBuiltinError(term, "");
+  }
+
+ private:
+  static const Matrix& getMatrix(const Token& term, const k_value& value,
+                                 const k_string& builtin) {
+    if (!std::holds_alternative<k_matrix>(value)) {
+      throw ConversionError(term, "Expected a matrix argument for builtin `" +
+                                      builtin + "`.");
+    }
+
+    return *std::get<k_matrix>(value);
+  }
+
+  static size_t getSize(const Token& term, const k_value& value,
+                        const k_string& builtin) {
+    if (!std::holds_alternative<k_int>(value) || std::get<k_int>(value) < 0) {
+      throw InvalidOperationError(
+          term, "Expected a non-negative integer argument for builtin `" +
+                    builtin + "`.");
+    }
+
+    return static_cast<size_t>(std::get<k_int>(value));
+  }
+
+  static size_t getIndex(const Token& term, const k_value& value,
+                         size_t limit, const k_string& builtin) {
+    auto index = getSize(term, value, builtin);
+    if (index >= limit) {
+      throw RangeError(term, "Matrix index out of range.");
+    }
+
+    return index;
+  }
+
+  /// @brief Allocates a matrix, with a Kiwi error in place of a crash when
+  /// the shape is too large.
+  static k_matrix makeMatrix(const Token& term, size_t rows, size_t cols,
+                             const k_string& builtin, double fill = 0) {
+    if (Matrix::canHold(rows, cols)) {
+      try {
+        return std::make_shared<Matrix>(rows, cols, fill);
+      } catch (const std::bad_alloc&) {
+      }
+    }
+
+    throw InvalidOperationError(
+        term, "Matrix shape is too large for builtin `" + builtin + "`.");
+  }
+
+  static void checkSameShape(const Token& term, const Matrix& left,
+                             const Matrix& right, const k_string& builtin) {
+    if (left.rows != right.rows || left.cols != right.cols) {
+      throw InvalidOperationError(
+          term, "Expected matrices of the same shape for builtin `" +
+                    builtin + "`.");
+    }
+  }
+
+  static k_value executeNew(const Token& term,
+                            const std::vector<k_value>& args) {
+    if (args.size() != 2 && args.size() != 3) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.New);
+    }
+
+    auto rows = getSize(term, args.at(0), MatrixBuiltins.New);
+    auto cols = getSize(term, args.at(1), MatrixBuiltins.New);
+    auto fill = args.size() == 3 ? MathImpl.get_double(term, args.at(2)) : 0.0;
+
+    return makeMatrix(term, rows, cols, MatrixBuiltins.New, fill);
+  }
+
+  static k_value executeFromList(const Token& term,
+                                 const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.FromList);
+    }
+
+    if (!std::holds_alternative<k_list>(args.at(0))) {
+      throw ConversionError(term, "Expected a list argument for builtin `" +
+                                      MatrixBuiltins.FromList + "`.");
+    }
+
+    const auto& rows = std::get<k_list>(args.at(0))->elements;
+    size_t cols = 0;
+    for (size_t row = 0; row < rows.size(); ++row) {
+      if (!std::holds_alternative<k_list>(rows[row])) {
+        throw ConversionError(term, "Expected a list of lists for builtin `" +
+                                        MatrixBuiltins.FromList + "`.");
+      }
+
+      auto size = std::get<k_list>(rows[row])->elements.size();
+      if (row > 0 && size != cols) {
+        throw InvalidOperationError(
+            term, "Expected rows of the same size for builtin `" +
+                      MatrixBuiltins.FromList + "`.");
+      }
+      cols = size;
+    }
+
+    auto matrix =
+        makeMatrix(term, rows.size(), cols, MatrixBuiltins.FromList);
+    for (size_t row = 0; row < rows.size(); ++row) {
+      const auto& cells = std::get<k_list>(rows[row])->elements;
+      for (size_t col = 0; col < cols; ++col) {
+        matrix->at(row, col) = MathImpl.get_double(term, cells[col]);
+      }
+    }
+
+    return matrix;
+  }
+
+  static k_value executeToList(const Token& term,
+                               const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.ToList);
+    }
+
+    const auto& matrix = getMatrix(term, args.at(0), MatrixBuiltins.ToList);
+    auto list = std::make_shared<List>();
+    auto& rows = list->elements;
+    rows.reserve(matrix.rows);
+
+    for (size_t row = 0; row < matrix.rows; ++row) {
+      auto rowList = std::make_shared<List>();
+      auto& cells = rowList->elements;
+      cells.reserve(matrix.cols);
+      for (size_t col = 0; col < matrix.cols; ++col) {
+        cells.emplace_back(matrix.at(row, col));
+      }
+      rows.emplace_back(rowList);
+    }
+
+    return list;
+  }
+
+  static k_value executeShape(const Token& term,
+                              const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.Shape);
+    }
+
+    const auto& matrix = getMatrix(term, args.at(0), MatrixBuiltins.Shape);
+    auto list = std::make_shared<List>();
+    list->elements.emplace_back(static_cast<k_int>(matrix.rows));
+    list->elements.emplace_back(static_cast<k_int>(matrix.cols));
+    return list;
+  }
+
+  static k_value executeGet(const Token& term,
+                            const std::vector<k_value>& args) {
+    if (args.size() != 3) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.Get);
+    }
+
+    const auto& matrix = getMatrix(term, args.at(0), MatrixBuiltins.Get);
+    auto row = getIndex(term, args.at(1), matrix.rows, MatrixBuiltins.Get);
+    auto col = getIndex(term, args.at(2), matrix.cols, MatrixBuiltins.Get);
+    return matrix.at(row, col);
+  }
+
+  /// @brief Sets a cell in place and returns the matrix.
+  static k_value executeSet(const Token& term,
+                            const std::vector<k_value>& args) {
+    if (args.size() != 4) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.Set);
+    }
+
+    getMatrix(term, args.at(0), MatrixBuiltins.Set);
+    auto& matrix = *std::get<k_matrix>(args.at(0));
+    auto row = getIndex(term, args.at(1), matrix.rows, MatrixBuiltins.Set);
+    auto col = getIndex(term, args.at(2), matrix.cols, MatrixBuiltins.Set);
+    matrix.at(row, col) = MathImpl.get_double(term, args.at(3));
+    return args.at(0);
+  }
+
+  /// @brief Copies the rows from `rowStart` up to `rowEnd` and the columns
+  /// from `colStart` up to `colEnd`, not including the ends.
+  static k_value executeSlice(const Token& term,
+                              const std::vector<k_value>& args) {
+    if (args.size() != 5) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.Slice);
+    }
+
+    const auto& matrix = getMatrix(term, args.at(0), MatrixBuiltins.Slice);
+    auto rowStart = getSize(term, args.at(1), MatrixBuiltins.Slice);
+    auto rowEnd = getSize(term, args.at(2), MatrixBuiltins.Slice);
+    auto colStart = getSize(term, args.at(3), MatrixBuiltins.Slice);
+    auto colEnd = getSize(term, args.at(4), MatrixBuiltins.Slice);
+
+    if (rowStart > rowEnd || rowEnd > matrix.rows || colStart > colEnd ||
+        colEnd > matrix.cols) {
+      throw RangeError(term, "Matrix slice out of range.");
+    }
+
+    auto slice = std::make_shared<Matrix>(rowEnd - rowStart, colEnd - colStart);
+    for (auto row = rowStart; row < rowEnd; ++row) {
+      const auto* cells = &matrix.cells[row * matrix.cols];
+      std::copy(cells + colStart, cells + colEnd,
+                &slice->cells[(row - rowStart) * slice->cols]);
+    }
+
+    return slice;
+  }
+
+  /// @brief Combines a matrix cell by cell with a matrix of the same shape,
+  /// or with a number.
+  template <typename Op>
+  static k_value executeZip(const Token& term, const std::vector<k_value>& args,
+                            const k_string& builtin, Op op) {
+    if (args.size() != 2) {
+      throw BuiltinUnexpectedArgumentError(term, builtin);
+    }
+
+    const auto& left = getMatrix(term, args.at(0), builtin);
+    const auto& rightValue = args.at(1);
+
+    if (!std::holds_alternative<k_matrix>(rightValue)) {
+      return MatrixKernels::zipScalar(
+          left, MathImpl.get_double(term, rightValue), op);
+    }
+
+    const auto& right = *std::get<k_matrix>(rightValue);
+    checkSameShape(term, left, right, builtin);
+    return MatrixKernels::zip(left, right, op);
+  }
+
+  /// @brief Reduces a whole matrix to a number, or with an axis, each column
+  /// (axis 0) or each row (axis 1) to a list.
+  static k_value executeReduce(const Token& term,
+                               const std::vector<k_value>& args,
+                               const k_string& builtin,
+                               MatrixKernels::Reduction reduction) {
+    if (args.size() != 1 && args.size() != 2) {
+      throw BuiltinUnexpectedArgumentError(term, builtin);
+    }
+
+    const auto& matrix = getMatrix(term, args.at(0), builtin);
+    if (matrix.cells.empty() &&
+        reduction != MatrixKernels::Reduction::Sum) {
+      throw InvalidOperationError(
+          term, "Expected a non-empty matrix for builtin `" + builtin + "`.");
+    }
+
+    if (args.size() == 1) {
+      return MatrixKernels::reduce(matrix, reduction);
+    }
+
+    const auto& axis = args.at(1);
+    if (!std::holds_alternative<k_int>(axis) ||
+        (std::get<k_int>(axis) != 0 && std::get<k_int>(axis) != 1)) {
+      throw InvalidOperationError(
+          term, "Expected an axis of 0 or 1 for builtin `" + builtin + "`.");
+    }
+
+    auto totals = MatrixKernels::reduceAxis(
+        matrix, reduction, static_cast<int>(std::get<k_int>(axis)));
+    auto list = std::make_shared<List>();
+    list->elements.reserve(totals.size());
+    for (auto total : totals) {
+      list->elements.emplace_back(total);
+    }
+    return list;
+  }
+
+  static k_value executeTranspose(const Token& term,
+                                  const std::vector<k_value>& args) {
+    if (args.size() != 1) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.Transpose);
+    }
+
+    return MatrixKernels::transpose(
+        getMatrix(term, args.at(0), MatrixBuiltins.Transpose));
+  }
+
+  static k_value executeMatMul(const Token& term,
+                               const std::vector<k_value>& args) {
+    if (args.size() != 2) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.MatMul);
+    }
+
+    const auto& left = getMatrix(term, args.at(0), MatrixBuiltins.MatMul);
+    const auto& right = getMatrix(term, args.at(1), MatrixBuiltins.MatMul);
+    if (left.cols != right.rows) {
+      throw InvalidOperationError(
+          term, "Expected the columns of the first matrix to match the rows "
+                "of the second for builtin `" +
+                    MatrixBuiltins.MatMul + "`.");
+    }
+
+    return MatrixKernels::multiply(left, right);
+  }
+
+  static k_value executeConvolve(const Token& term,
+                                 const std::vector<k_value>& args) {
+    if (args.size() != 2 && args.size() != 3) {
+      throw BuiltinUnexpectedArgumentError(term, MatrixBuiltins.Convolve);
+    }
+
+    const auto& matrix = getMatrix(term, args.at(0), MatrixBuiltins.Convolve);
+    const auto& kernel = getMatrix(term, args.at(1), MatrixBuiltins.Convolve);
+    auto wrap = args.size() == 3 && MathImpl.is_truthy(args.at(2));
+
+    if (kernel.rows % 2 == 0 || kernel.cols % 2 == 0) {
+      throw InvalidOperationError(
+          term, "Expected a kernel with an odd number of rows and columns "
+                "for builtin `" +
+                    MatrixBuiltins.Convolve + "`.");
+    }
+
+    return MatrixKernels::convolve(matrix, kernel, wrap);
+  }
+};
+
+#endif
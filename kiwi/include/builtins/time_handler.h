@@ -150,12 +150,12 @@ class TimeBuiltinHandler {
     }
 
     try {
-      year = get_integer(term, dateValue->instanceVariables["year"]);
-      month = get_integer(term, dateValue->instanceVariables["month"]);
-      day = get_integer(term, dateValue->instanceVariables["day"]);
-      hour = get_integer(term, dateValue->instanceVariables["hour"]);
-      minute = get_integer(term, dateValue->instanceVariables["minute"]);
-      second = get_integer(term, dateValue->instanceVariables["second"]);
+      year = get_integer(term, dateValue->getVariable("@year"));
+      month = get_integer(term, dateValue->getVariable("@month"));
+      day = get_integer(term, dateValue->getVariable("@day"));
+      hour = get_integer(term, dateValue->getVariable("@hour"));
+      minute = get_integer(term, dateValue->getVariable("@minute"));
+      second = get_integer(term, dateValue->getVariable("@second"));
     } catch (const std::exception& e) {
       throw InvalidOperationError(term, "Expected a DateTime object.");
     }
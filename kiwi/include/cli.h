@@ -6,12 +6,16 @@
 
 #include "tracing/error.h"
 #include "tracing/handler.h"
+#include "tracing/chrometrace.h"
+#include "tracing/heatmap.h"
+#include "tracing/profiler.h"
 #include "logging/logger.h"
 #include "math/rng.h"
 #include "parsing/keywords.h"
 #include "parsing/tokens.h"
 #include "util/file.h"
 #include "util/string.h"
+#include "util/sys.h"
 #include "web/httplib.h"
 #include "typing/value.h"
 #include "globals.h"
@@ -21,7 +25,7 @@
 //TaskManager task;
 
 std::unordered_map<std::string, std::string> kiwiArgs;
-std::stack<std::shared_ptr<CallStackFrame>> callStack;
+FrameStack callStack;
 std::stack<std::string> packageStack;
 bool SILENCE = false;
 
@@ -36,6 +40,7 @@ class KiwiCLI {
   static bool parse(Host& host, const std::string& content);
   static bool tokenize(Host& host, const std::string& path);
   static bool printAST(Host& host, const std::string& path);
+  static void enableMemoryReport();
 
   static int printVersion();
   static int printHelp();
@@ -49,7 +54,8 @@ int KiwiCLI::run(int argc, char** argv) {
     args.emplace_back(argv[i]);
   }
 
-  return KiwiCLI::run(args);
+  return Sys::runWithStack(FrameStack::InterpreterStackSize,
+                           [&args]() { return KiwiCLI::run(args); });
 }
 
 int KiwiCLI::run(std::vector<std::string>& v) {
@@ -99,6 +105,63 @@ int KiwiCLI::run(std::vector<std::string>& v) {
           return KiwiCLI::tokenize(host, v.at(++i));
         }
 
+        help = true;
+      } else if (String::isCLIFlag(v.at(i), "P", "profile")) {
+        if (i + 1 < size && !File::isScript(v.at(i + 1))) {
+          Profiler::getInstance().start(v.at(++i));
+          continue;
+        }
+
+        help = true;
+      } else if (String::isCLIFlag(v.at(i), "H", "heatmap")) {
+        if (i + 1 < size && !File::isScript(v.at(i + 1))) {
+          Heatmap::getInstance().start(v.at(++i));
+          continue;
+        }
+
+        help = true;
+      } else if (String::isCLIFlag(v.at(i), "T", "trace")) {
+        if (i + 1 < size && !File::isScript(v.at(i + 1))) {
+          TraceRecorder::getInstance().start(v.at(++i));
+          continue;
+        }
+
+        help = true;
+      } else if (String::isCLIFlag(v.at(i), "trace-threshold",
+                                   "trace-threshold")) {
+        if (i + 1 < size && !v.at(i + 1).empty() &&
+            std::all_of(v.at(i + 1).begin(), v.at(i + 1).end(), ::isdigit)) {
+          TraceRecorder::setCallThreshold(std::stoll(v.at(++i)));
+          continue;
+        }
+
+        help = true;
+      } else if (String::isCLIFlag(v.at(i), "gc-threshold", "gc-threshold")) {
+        if (i + 1 < size && !v.at(i + 1).empty() &&
+            std::all_of(v.at(i + 1).begin(), v.at(i + 1).end(), ::isdigit)) {
+          CycleCollector::setThreshold(std::stoll(v.at(++i)));
+          continue;
+        }
+
+        help = true;
+      } else if (String::isCLIFlag(v.at(i), "max-depth", "max-depth")) {
+        if (i + 1 < size && !v.at(i + 1).empty() &&
+            std::all_of(v.at(i + 1).begin(), v.at(i + 1).end(), ::isdigit)) {
+          FrameStack::setMaxDepth(std::stoull(v.at(++i)));
+          continue;
+        }
+
+        help = true;
+      } else if (String::isCLIFlag(v.at(i), "M", "mem-report")) {
+        KiwiCLI::enableMemoryReport();
+      } else if (String::isCLIFlag(v.at(i), "mem-sample", "mem-sample")) {
+        if (i + 1 < size && !v.at(i + 1).empty() &&
+            std::all_of(v.at(i + 1).begin(), v.at(i + 1).end(), ::isdigit)) {
+          MemoryStats::startSampling(std::stoi(v.at(++i)));
+          KiwiCLI::enableMemoryReport();
+          continue;
+        }
+
         help = true;
       } else if (File::isScript(v.at(i))) {
         host.registerScript(v.at(i));
@@ -125,6 +188,16 @@ int KiwiCLI::run(std::vector<std::string>& v) {
   }
 }
 
+void KiwiCLI::enableMemoryReport() {
+  static bool enabled = false;
+
+  if (!enabled) {
+    enabled = true;
+    FileRegistry::getInstance();
+    std::atexit([]() { KInterpreter::printMemoryReport(); });
+  }
+}
+
 bool KiwiCLI::parse(Host& host, const std::string& content) {
   return host.parse(content);
 }
@@ -243,6 +316,20 @@ int KiwiCLI::printHelp() {
       {"-m, --minify <input_file_path>", "create a `.min.🥝` file"},
       {"-t, --tokenize <input_file_path>",
        "tokenize a file with the kiwi lexer"},
+      {"-P, --profile <output_path>",
+       "sample the call stack and write collapsed stacks"},
+      {"-H, --heatmap <output_path>",
+       "write per-line execution counts and timings"},
+      {"-T, --trace <output_path>",
+       "write Chrome trace events for requests and slow calls"},
+      {"--trace-threshold <microseconds>",
+       "record calls slower than this in the trace"},
+      {"--gc-threshold <count>",
+       "allocations between cycle collections, or 0 to turn them off"},
+      {"--max-depth <count>", "the deepest the call stack may grow"},
+      {"-M, --mem-report", "print memory usage by value type at exit"},
+      {"--mem-sample <interval>",
+       "attribute every n-th allocation to a source line"},
       {"-X<key>=<value>", "specify an argument as a key-value pair"}};
 
 #ifdef _WIN64
@@ -254,6 +341,18 @@ int KiwiCLI::printHelp() {
       {"-n, --new <filename>", "create a `.kiwi` file"},
       {"-m, --minify <input_file_path>", "create a `.min.kiwi` file"},
       {"-t, --tokenize <input_file_path>", "tokenize a file as kiwi code"},
+      {"-H, --heatmap <output_path>",
+       "write per-line execution counts and timings"},
+      {"-T, --trace <output_path>",
+       "write Chrome trace events for requests and slow calls"},
+      {"--trace-threshold <microseconds>",
+       "record calls slower than this in the trace"},
+      {"--gc-threshold <count>",
+       "allocations between cycle collections, or 0 to turn them off"},
+      {"--max-depth <count>", "the deepest the call stack may grow"},
+      {"-M, --mem-report", "print memory usage by value type at exit"},
+      {"--mem-sample <interval>",
+       "attribute every n-th allocation to a source line"},
       {"-X<key>=<value>", "specify an argument as a key-value pair"}};
 #endif
 
@@ -33,7 +33,7 @@ extern Logger logger;
 //extern TaskManager task;
 
 extern std::unordered_map<std::string, std::string> kiwiArgs;
-extern std::stack<std::shared_ptr<CallStackFrame>> callStack;
+extern FrameStack callStack;
 extern std::stack<std::string> packageStack;
 
 #endif
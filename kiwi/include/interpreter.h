@@ -2,10 +2,14 @@
 #define KIWI_INTERPRETER_H
 
 #include <algorithm>
+#include <array>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
+#include <unordered_set>
 
 #include "globals.h"
 #include "builtin.h"
@@ -13,15 +17,25 @@
 #include "math/functions.h"
 #include "parsing/ast.h"
 #include "parsing/builtins.h"
+#include "tracing/chrometrace.h"
 #include "tracing/error.h"
+#include "tracing/heatmap.h"
+#include "tracing/hooks.h"
+#include "tracing/memmeter.h"
+#include "tracing/memstats.h"
+#include "tracing/profiler.h"
+#include "tracing/runtimestats.h"
 #include "typing/value.h"
 #include "util/file.h"
+#include "util/sys.h"
 
 std::unordered_map<k_string, std::unique_ptr<KPackage>> packages;
 std::unordered_map<k_string, std::unique_ptr<KFunction>> functions;
 std::unordered_map<k_string, std::unique_ptr<KFunction>> methods;
 std::unordered_map<k_string, std::unique_ptr<KLambda>> lambdas;
 std::unordered_map<k_string, std::unique_ptr<KClass>> classes;
+// Redefined classes are kept, since method tables may still point into them.
+std::vector<std::unique_ptr<KClass>> retiredClasses;
 httplib::Server server;
 std::unordered_map<int, k_string> serverHooks;
 
@@ -35,10 +49,44 @@ class KInterpreter {
 
   k_value interpret(const ASTNode* node);
 
+  static k_hash getMemoryStats();
+  static k_hash getRuntimeStats();
+  static void printMemoryReport();
+
  private:
+  /// @brief A call made by a `return` in tail position, which the function
+  /// body that made it runs in place of returning.
+  struct TailCall {
+    const KFunction* function = nullptr;
+    std::vector<k_value> arguments;
+  };
+
+  /// @brief Drops the frame on top of the stack when the call that pushed
+  /// it ends, whether it returns or an error unwinds it.
+  class FrameScope {
+   public:
+    explicit FrameScope(KInterpreter& interpreter) : interpreter(interpreter) {}
+    ~FrameScope() { interpreter.dropFrame(); }
+
+    FrameScope(const FrameScope&) = delete;
+    FrameScope& operator=(const FrameScope&) = delete;
+
+   private:
+    KInterpreter& interpreter;
+  };
+
   std::stack<k_string> classStack;
+  TailCall tailCall;
+
+  /// @brief The error thrown by a `throw` that a `try` in the same frame
+  /// catches, carried by a `Throw` completion instead of a C++ exception.
+  std::optional<KiwiError> pendingError;
 
+  k_value dispatch(const ASTNode* node);
+  k_value interpretHooked(const ASTNode* node);
   std::shared_ptr<CallStackFrame> createFrame(bool isMethodInvocation);
+  void pushFrame(const std::shared_ptr<CallStackFrame>& frame,
+                 const Token& token);
   k_value dropFrame();
   void importPackage(const k_value& packageName, const Token& token);
   void importExternal(const k_string& packageName);
@@ -84,20 +132,29 @@ class KInterpreter {
 
   k_value callBuiltinMethod(const FunctionCallNode* node);
   k_value callClassMethod(const MethodCallNode* node, const k_class& clazz);
-  k_value callObjectBaseMethod(const MethodCallNode* node,
-                               const std::shared_ptr<Object>& obj,
-                               const k_string& baseClass,
-                               const k_string& methodName);
   k_value callObjectMethod(const MethodCallNode* node,
                            const std::shared_ptr<Object>& obj);
-  k_value executeFunctionBody(const std::unique_ptr<KFunction>& function);
+  k_value executeFunctionBody(const KFunction& function);
+  k_value executeBlock(const std::vector<std::unique_ptr<ASTNode>>& block,
+                       CallStackFrame& frame);
+  bool executeLoopBody(const std::vector<std::unique_ptr<ASTNode>>& body,
+                       CallStackFrame& frame, k_value& result);
+  void executeFinally(const TryNode* node, CallStackFrame& frame);
+  void rebuildSubclasses(const k_string& className);
+  bool prepareTailCall(const FunctionCallNode* node);
   k_value callLambda(std::shared_ptr<CallStackFrame>& lambdaFrame,
                      const Token& token, const k_string& lambdaName,
                      const std::vector<std::unique_ptr<ASTNode>>& arguments);
-  k_value callFunction(const std::unique_ptr<KFunction>& function,
+  k_value callFunction(const KFunction& function,
                        const std::vector<std::unique_ptr<ASTNode>>& arguments,
                        const Token& token, const std::string& functionName);
-  KCallableType getCallable(const Token& token, const std::string& name) const;
+  void bindArguments(const KCallable& callable, CallStackFrame& frame,
+                     const std::vector<std::unique_ptr<ASTNode>>& arguments,
+                     const Token& token, const std::string& name);
+  void bindParameter(const std::pair<k_string, k_value>& param,
+                     k_value argValue, CallStackFrame& frame);
+  KCallableType getCallable(const Token& token, const std::string& name,
+                            int methodId) const;
   std::unique_ptr<KFunction> createFunction(const FunctionDeclarationNode* node,
                                             const std::string& name);
   k_value doSliceAssignment(const Token& token, k_value& slicedObj,
@@ -148,6 +205,42 @@ class KInterpreter {
 };
 
 k_value KInterpreter::interpret(const ASTNode* node) {
+  RuntimeStats::increment(RuntimeCounter::Nodes);
+
+  if (InterpreterHooks::any()) {
+    return interpretHooked(node);
+  }
+
+  return dispatch(node);
+}
+
+k_value KInterpreter::interpretHooked(const ASTNode* node) {
+  if (!node) {
+    return {};
+  }
+
+  if (InterpreterHooks::isSet(InterpreterHook::Sample)) {
+    Profiler::getInstance().sample(node->token);
+  }
+
+  if (InterpreterHooks::isSet(InterpreterHook::Collect)) {
+    CycleCollector::collectDue();
+  }
+
+  if (InterpreterHooks::isSet(InterpreterHook::MemorySites) &&
+      node->token.getType() != KTokenType::ENDOFFILE) {
+    MemoryStats::setSite(node->token.getFile(), node->token.getLineNumber());
+  }
+
+  if (InterpreterHooks::isSet(InterpreterHook::LineCounts)) {
+    HeatmapScope heatmapScope(node->token);
+    return dispatch(node);
+  }
+
+  return dispatch(node);
+}
+
+k_value KInterpreter::dispatch(const ASTNode* node) {
   if (!node) {
     return {};
   }
@@ -277,8 +370,9 @@ k_value KInterpreter::interpret(const ASTNode* node) {
 
 std::shared_ptr<CallStackFrame> KInterpreter::createFrame(
     bool isMethodInvocation = false) {
+  RuntimeStats::increment(RuntimeCounter::Frames);
   std::shared_ptr<CallStackFrame> frame = callStack.top();
-  auto subFrame = std::make_shared<CallStackFrame>();
+  auto subFrame = make_frame();
   auto& subFrameVariables = subFrame->variables;
 
   if (!isMethodInvocation) {
@@ -304,6 +398,18 @@ std::shared_ptr<CallStackFrame> KInterpreter::createFrame(
   return subFrame;
 }
 
+void KInterpreter::pushFrame(const std::shared_ptr<CallStackFrame>& frame,
+                             const Token& token) {
+  callStack.push(frame);
+  RuntimeStats::onFramePushed(callStack.size());
+
+  if (callStack.isOverflowing()) {
+    auto depth = callStack.size();
+    callStack.pop();
+    throw StackOverflowError(token, depth);
+  }
+}
+
 k_value KInterpreter::dropFrame() {
   auto frame = callStack.top();
   auto returnValue = std::move(frame->returnValue);
@@ -317,7 +423,7 @@ k_value KInterpreter::dropFrame() {
     callerFrame->returnValue = returnValue;
 
     if (callerFrame->isFlagSet(FrameFlags::SubFrame)) {
-      callerFrame->setFlag(FrameFlags::Return);
+      callerFrame->completion = Completion::Return;
     }
 
     InterpHelper::updateVariablesInCallerFrame(topVariables, callerFrame);
@@ -333,9 +439,9 @@ k_string KInterpreter::id(const ASTNode* node) {
 k_value KInterpreter::visit(const ProgramNode* node) {
   // This is the program root
   if (!node->isScript) {
-    auto programFrame = std::make_shared<CallStackFrame>();
+    auto programFrame = make_frame();
     programFrame->variables[Keywords.Global] = std::make_shared<Hash>();
-    callStack.push(programFrame);
+    pushFrame(programFrame, node->token);
   }
 
   k_value result;
@@ -370,12 +476,30 @@ k_value KInterpreter::visit(const ReturnNode* node) {
 
   if (!node->condition ||
       MathImpl.is_truthy(interpret(node->condition.get()))) {
-    if (node->returnValue) {
-      returnValue = interpret(node->returnValue.get());
+    auto frame = callStack.top();
+    const auto* value = node->returnValue.get();
+
+    if (node->isTailCall) {
+      while (value->type == ASTNodeType::TERNARY_OPERATION) {
+        const auto* ternary = static_cast<const TernaryOperationNode*>(value);
+        value = MathImpl.is_truthy(interpret(ternary->evalExpression.get()))
+                    ? ternary->trueExpression.get()
+                    : ternary->falseExpression.get();
+      }
+
+      if (value->type == ASTNodeType::FUNCTION_CALL &&
+          prepareTailCall(static_cast<const FunctionCallNode*>(value))) {
+        frame->completion = Completion::TailCall;
+        frame->returnValue = {};
+        return {};
+      }
     }
 
-    auto frame = callStack.top();
-    frame->setFlag(FrameFlags::Return);
+    if (value) {
+      returnValue = interpret(value);
+    }
+
+    frame->completion = Completion::Return;
     frame->returnValue = returnValue;
     return returnValue;
   }
@@ -406,6 +530,15 @@ k_value KInterpreter::visit(const ThrowNode* node) {
       }
     }
 
+    // A `try` running in this frame is reached by completing abruptly
+    // through the enclosing blocks, without unwinding the C++ stack.
+    auto& frame = callStack.top();
+    if (frame->tryDepth > 0) {
+      pendingError.emplace(node->token, errorType, errorMessage);
+      frame->completion = Completion::Throw;
+      return {};
+    }
+
     throw KiwiError(node->token, errorType, errorMessage);
   }
 
@@ -425,6 +558,8 @@ void KInterpreter::importExternal(const k_string& packageName) {
     return;
   }
 
+  RuntimeStats::increment(RuntimeCounter::Imports);
+
   Lexer lexer(packageName, content);
 
   Parser p;
@@ -453,6 +588,7 @@ void KInterpreter::importPackage(const k_value& packageName,
     throw PackageUndefinedError(token, packageNameValue);
   }
 
+  RuntimeStats::increment(RuntimeCounter::Imports);
   packageStack.push(packageNameValue);
   const auto& package = packages[packageNameValue];
   const auto& decl = *package->decl;
@@ -760,8 +896,9 @@ k_value KInterpreter::visit(const AssignmentNode* node) {
       if (frame->inObjectContext() &&
           (node->left->type == ASTNodeType::SELF || name.at(0) == '@')) {
         auto& obj = frame->getObjectContext();
-        obj->instanceVariables[name] = value;
-        return obj->instanceVariables[name];
+        auto& variable = obj->getVariable(name, node->slotCache);
+        variable = value;
+        return variable;
       }
 
       if (std::holds_alternative<k_object>(value)) {
@@ -785,22 +922,19 @@ k_value KInterpreter::visit(const AssignmentNode* node) {
       return frame->variables[name];
     } else if (frame->inObjectContext()) {
       auto& obj = frame->getObjectContext();
+      auto variable = obj->findVariable(name, node->slotCache);
 
-      if (!obj->hasVariable(name)) {
+      if (!variable) {
         throw VariableUndefinedError(node->token, name);
       }
 
-      auto oldValue = obj->instanceVariables[name];
-
       if (type == KName::Ops_BitwiseNotAssign) {
-        obj->instanceVariables[name] =
-            MathImpl.do_bitwise_not(node->token, oldValue);
+        *variable = MathImpl.do_bitwise_not(node->token, *variable);
       } else {
-        obj->instanceVariables[name] =
-            MathImpl.do_binary_op(node->token, type, oldValue, value);
+        *variable = MathImpl.do_binary_op(node->token, type, *variable, value);
       }
 
-      return obj->instanceVariables[name];
+      return *variable;
     }
 
     throw VariableUndefinedError(node->token, name);
@@ -840,29 +974,24 @@ SliceIndex KInterpreter::getSlice(const SliceNode* node, k_value object) {
 }
 
 k_value KInterpreter::visit(const SelfNode* node) {
-  auto frame = callStack.top();
+  const auto& frame = callStack.top();
 
   if (!frame->inObjectContext()) {
     throw InvalidContextError(node->token);
   }
 
   if (!node->name.empty()) {
-    auto name = node->name;
-    auto obj = frame->getObjectContext();
-    if (!obj->hasVariable(name)) {
-      obj->instanceVariables[name] = {};
-    }
-    return obj->instanceVariables[name];
+    return frame->getObjectContext()->getVariable(node->name, node->slotCache);
   }
 
   return frame->getObjectContext();
 }
 
 k_value KInterpreter::visit(const IdentifierNode* node) {
-  auto frame = callStack.top();
+  const auto& frame = callStack.top();
 
   if (frame->inObjectContext() && node->name.at(0) == '@') {
-    return frame->getObjectContext()->instanceVariables[node->name];
+    return frame->getObjectContext()->getVariable(node->name, node->slotCache);
   }
 
   if (frame->hasVariable(node->name)) {
@@ -976,7 +1105,16 @@ k_value KInterpreter::visit(const BinaryOperationNode* node) {
     }
   }
   auto right = interpret(node->right.get());
-  return MathImpl.do_binary_op(node->token, node->op, left, right);
+
+  if (auto handler = node->opCache.find(left, right)) {
+    return handler(node->token, left, right);
+  }
+
+  if (auto handler = node->opCache.quicken(op, left, right)) {
+    return handler(node->token, left, right);
+  }
+
+  return MathImpl.do_binary_op(node->token, op, left, right);
 }
 
 k_value KInterpreter::visit(const TernaryOperationNode* node) {
@@ -1061,35 +1199,20 @@ k_value KInterpreter::visit(const IfNode* node) {
   auto frame = callStack.top();
 
   if (MathImpl.is_truthy(conditionValue)) {
-    for (const auto& stmt : node->body) {
-      interpret(stmt.get());
-      if (frame->isFlagSet(FrameFlags::Return)) {
-        break;
-      }
-    }
+    executeBlock(node->body, *frame);
   } else {
     bool executed = false;
     for (const auto& elseifNode : node->elseifNodes) {
       auto elseifConditionValue = interpret(elseifNode->condition.get());
       if (MathImpl.is_truthy(elseifConditionValue)) {
-        for (const auto& stmt : elseifNode->body) {
-          interpret(stmt.get());
-          if (frame->isFlagSet(FrameFlags::Return)) {
-            break;
-          }
-        }
+        executeBlock(elseifNode->body, *frame);
         executed = true;
         break;
       }
     }
 
     if (!executed && !node->elseBody.empty()) {
-      for (const auto& stmt : node->elseBody) {
-        interpret(stmt.get());
-        if (frame->isFlagSet(FrameFlags::Return)) {
-          break;
-        }
-      }
+      executeBlock(node->elseBody, *frame);
     }
   }
 
@@ -1099,22 +1222,32 @@ k_value KInterpreter::visit(const IfNode* node) {
 k_value KInterpreter::visit(const CaseNode* node) {
   k_value testValue = interpret(node->testValue.get());
 
+  if (node->testValue) {
+    std::call_once(node->jumpTableOnce, [node]() {
+      node->jumpTable = CaseJumpTable::build(node->whenNodes);
+    });
+  }
+
+  if (node->jumpTable) {
+    auto match = node->jumpTable->find(testValue);
+    const auto& body = match == CaseJumpTable::NoMatch
+                           ? node->elseBody
+                           : node->whenNodes[match]->body;
+    executeBlock(body, *callStack.top());
+    return {};
+  }
+
   for (const auto& whenNode : node->whenNodes) {
     k_value whenCondition = interpret(whenNode->condition.get());
 
     if (std::get<bool>(MathImpl.do_eq_comparison(testValue, whenCondition))) {
-      for (const auto& stmt : whenNode->body) {
-        interpret(stmt.get());
-      }
-
+      executeBlock(whenNode->body, *callStack.top());
       return {};
     }
   }
 
   if (!node->elseBody.empty()) {
-    for (const auto& stmt : node->elseBody) {
-      interpret(stmt.get());
-    }
+    executeBlock(node->elseBody, *callStack.top());
   }
 
   return {};
@@ -1122,7 +1255,8 @@ k_value KInterpreter::visit(const CaseNode* node) {
 
 k_value KInterpreter::listLoop(const ForLoopNode* node, const k_list& list) {
   auto frame = callStack.top();
-  frame->setFlag(FrameFlags::InLoop);
+  FrameDepthScope loopScope(frame->loopDepth,
+                            static_cast<uint16_t>(frame->loopDepth + 1));
   const auto& elements = list->elements;
 
   k_string valueIteratorName;
@@ -1136,55 +1270,17 @@ k_value KInterpreter::listLoop(const ForLoopNode* node, const k_list& list) {
     hasIndexIterator = true;
   }
 
-  bool fallOut = false;
   k_value result;
 
   for (size_t i = 0; i < elements.size(); ++i) {
-    if (fallOut) {
-      break;
-    }
-
     frame->variables[valueIteratorName] = elements.at(i);
 
     if (hasIndexIterator) {
       frame->variables[indexIteratorName] = static_cast<k_int>(i);
     }
 
-    for (const auto& stmt : node->body) {
-      if (stmt->type != ASTNodeType::NEXT_STATEMENT &&
-          stmt->type != ASTNodeType::BREAK_STATEMENT) {
-        result = interpret(stmt.get());
-
-        if (frame->isFlagSet(FrameFlags::Break)) {
-          frame->clearFlag(FrameFlags::Break);
-          fallOut = true;
-          break;
-        }
-
-        if (frame->isFlagSet(FrameFlags::Next)) {
-          frame->clearFlag(FrameFlags::Next);
-          break;
-        }
-      }
-
-      if (frame->isFlagSet(FrameFlags::Return)) {
-        break;
-      }
-
-      if (stmt->type == ASTNodeType::NEXT_STATEMENT) {
-        const auto* nextNode = static_cast<const NextNode*>(stmt.get());
-        if (!nextNode->condition ||
-            MathImpl.is_truthy(interpret(nextNode->condition.get()))) {
-          break;
-        }
-      } else if (stmt->type == ASTNodeType::BREAK_STATEMENT) {
-        const auto* breakNode = static_cast<const BreakNode*>(stmt.get());
-        if (!breakNode->condition ||
-            MathImpl.is_truthy(interpret(breakNode->condition.get()))) {
-          fallOut = true;
-          break;
-        }
-      }
+    if (executeLoopBody(node->body, *frame, result)) {
+      break;
     }
   }
 
@@ -1193,14 +1289,13 @@ k_value KInterpreter::listLoop(const ForLoopNode* node, const k_list& list) {
     frame->variables.erase(indexIteratorName);
   }
 
-  frame->clearFlag(FrameFlags::InLoop);
-
   return result;
 }
 
 k_value KInterpreter::hashLoop(const ForLoopNode* node, const k_hash& hash) {
   auto frame = callStack.top();
-  frame->setFlag(FrameFlags::InLoop);
+  FrameDepthScope loopScope(frame->loopDepth,
+                            static_cast<uint16_t>(frame->loopDepth + 1));
   const auto& keys = hash->keys;
   const auto& kvp = hash->kvp;
 
@@ -1215,55 +1310,17 @@ k_value KInterpreter::hashLoop(const ForLoopNode* node, const k_hash& hash) {
     hasIndexIterator = true;
   }
 
-  bool fallOut = false;
   k_value result;
 
   for (const auto& key : keys) {
-    if (fallOut) {
-      break;
-    }
-
     frame->variables[valueIteratorName] = key;
 
     if (hasIndexIterator) {
       frame->variables[indexIteratorName] = kvp.at(key);
     }
 
-    for (const auto& stmt : node->body) {
-      if (stmt->type != ASTNodeType::NEXT_STATEMENT &&
-          stmt->type != ASTNodeType::BREAK_STATEMENT) {
-        result = interpret(stmt.get());
-
-        if (frame->isFlagSet(FrameFlags::Break)) {
-          frame->clearFlag(FrameFlags::Break);
-          fallOut = true;
-          break;
-        }
-
-        if (frame->isFlagSet(FrameFlags::Next)) {
-          frame->clearFlag(FrameFlags::Next);
-          break;
-        }
-      }
-
-      if (frame->isFlagSet(FrameFlags::Return)) {
-        break;
-      }
-
-      if (stmt->type == ASTNodeType::NEXT_STATEMENT) {
-        const auto* nextNode = static_cast<const NextNode*>(stmt.get());
-        if (!nextNode->condition ||
-            MathImpl.is_truthy(interpret(nextNode->condition.get()))) {
-          break;
-        }
-      } else if (stmt->type == ASTNodeType::BREAK_STATEMENT) {
-        const auto* breakNode = static_cast<const BreakNode*>(stmt.get());
-        if (!breakNode->condition ||
-            MathImpl.is_truthy(interpret(breakNode->condition.get()))) {
-          fallOut = true;
-          break;
-        }
-      }
+    if (executeLoopBody(node->body, *frame, result)) {
+      break;
     }
   }
 
@@ -1272,8 +1329,6 @@ k_value KInterpreter::hashLoop(const ForLoopNode* node, const k_hash& hash) {
     frame->variables.erase(indexIteratorName);
   }
 
-  frame->clearFlag(FrameFlags::InLoop);
-
   return result;
 }
 
@@ -1295,54 +1350,15 @@ k_value KInterpreter::visit(const ForLoopNode* node) {
 k_value KInterpreter::visit(const WhileLoopNode* node) {
   k_value result;
   auto frame = callStack.top();
-  frame->setFlag(FrameFlags::InLoop);
-  auto fallOut = false;
+  FrameDepthScope loopScope(frame->loopDepth,
+                            static_cast<uint16_t>(frame->loopDepth + 1));
 
   while (MathImpl.is_truthy(interpret(node->condition.get()))) {
-    for (const auto& stmt : node->body) {
-      if (stmt->type != ASTNodeType::NEXT_STATEMENT &&
-          stmt->type != ASTNodeType::BREAK_STATEMENT) {
-        result = interpret(stmt.get());
-
-        if (frame->isFlagSet(FrameFlags::Break)) {
-          frame->clearFlag(FrameFlags::Break);
-          fallOut = true;
-          break;
-        }
-
-        if (frame->isFlagSet(FrameFlags::Next)) {
-          frame->clearFlag(FrameFlags::Next);
-          break;
-        }
-      }
-
-      if (frame->isFlagSet(FrameFlags::Return)) {
-        break;
-      }
-
-      if (stmt->type == ASTNodeType::NEXT_STATEMENT) {
-        const auto* nextNode = static_cast<const NextNode*>(stmt.get());
-        if (!nextNode->condition ||
-            MathImpl.is_truthy(interpret(nextNode->condition.get()))) {
-          break;
-        }
-      } else if (stmt->type == ASTNodeType::BREAK_STATEMENT) {
-        const auto* breakNode = static_cast<const BreakNode*>(stmt.get());
-        if (!breakNode->condition ||
-            MathImpl.is_truthy(interpret(breakNode->condition.get()))) {
-          fallOut = true;
-          break;
-        }
-      }
-    }
-
-    if (fallOut) {
+    if (executeLoopBody(node->body, *frame, result)) {
       break;
     }
   }
 
-  frame->clearFlag(FrameFlags::InLoop);
-
   return result;
 }
 
@@ -1350,7 +1366,9 @@ k_value KInterpreter::visit(const BreakNode* node) {
   if (!node->condition ||
       MathImpl.is_truthy(interpret(node->condition.get()))) {
     auto& frame = callStack.top();
-    frame->setFlag(FrameFlags::Break);
+    if (frame->loopDepth > 0) {
+      frame->completion = Completion::Break;
+    }
   }
 
   return {};
@@ -1360,7 +1378,9 @@ k_value KInterpreter::visit(const NextNode* node) {
   if (!node->condition ||
       MathImpl.is_truthy(interpret(node->condition.get()))) {
     auto& frame = callStack.top();
-    frame->setFlag(FrameFlags::Next);
+    if (frame->loopDepth > 0) {
+      frame->completion = Completion::Next;
+    }
   }
 
   return {};
@@ -1383,53 +1403,16 @@ k_value KInterpreter::visit(const RepeatLoopNode* node) {
   }
 
   auto frame = callStack.top();
-  frame->setFlag(FrameFlags::InLoop);
+  FrameDepthScope loopScope(frame->loopDepth,
+                            static_cast<uint16_t>(frame->loopDepth + 1));
 
-  auto fallOut = false;
   for (k_int i = 1; i <= count; ++i) {
-    if (fallOut) {
-      break;
-    }
-
     if (hasAlias) {
       frame->variables[aliasName] = i;
     }
 
-    for (const auto& stmt : node->body) {
-      if (stmt->type != ASTNodeType::NEXT_STATEMENT &&
-          stmt->type != ASTNodeType::BREAK_STATEMENT) {
-        result = interpret(stmt.get());
-
-        if (frame->isFlagSet(FrameFlags::Break)) {
-          frame->clearFlag(FrameFlags::Break);
-          fallOut = true;
-          break;
-        }
-
-        if (frame->isFlagSet(FrameFlags::Next)) {
-          frame->clearFlag(FrameFlags::Next);
-          break;
-        }
-      }
-
-      if (frame->isFlagSet(FrameFlags::Return)) {
-        break;
-      }
-
-      if (stmt->type == ASTNodeType::NEXT_STATEMENT) {
-        const auto* nextNode = static_cast<const NextNode*>(stmt.get());
-        if (!nextNode->condition ||
-            MathImpl.is_truthy(interpret(nextNode->condition.get()))) {
-          break;
-        }
-      } else if (stmt->type == ASTNodeType::BREAK_STATEMENT) {
-        const auto* breakNode = static_cast<const BreakNode*>(stmt.get());
-        if (!breakNode->condition ||
-            MathImpl.is_truthy(interpret(breakNode->condition.get()))) {
-          fallOut = true;
-          break;
-        }
-      }
+    if (executeLoopBody(node->body, *frame, result)) {
+      break;
     }
   }
 
@@ -1437,36 +1420,43 @@ k_value KInterpreter::visit(const RepeatLoopNode* node) {
     frame->variables.erase(aliasName);
   }
 
-  frame->clearFlag(FrameFlags::InLoop);
-
   return result;
 }
 
 k_value KInterpreter::visit(const TryNode* node) {
+  auto frame = callStack.top();
+  std::optional<KiwiError> error;
+
+  // A `throw` directly in the body completes with `Throw`; errors from
+  // calls and builtins still arrive as exceptions.
   try {
-    for (const auto& stmt : node->tryBody) {
-      interpret(stmt.get());
-    }
+    FrameDepthScope tryScope(frame->tryDepth,
+                             static_cast<uint16_t>(frame->tryDepth + 1));
+    executeBlock(node->tryBody, *frame);
   } catch (const KiwiError& e) {
-    if (!node->catchBody.empty()) {
-      auto frame = callStack.top();
+    error.emplace(e);
+  }
 
-      k_string errorTypeName;
-      k_string errorMessageName;
-      if (node->errorType) {
-        errorTypeName = id(node->errorType.get());
-        frame->variables[errorTypeName] = e.getError();
-      }
+  if (frame->completion == Completion::Throw) {
+    frame->completion = Completion::Normal;
+    error = std::move(pendingError);
+    pendingError.reset();
+  }
 
-      if (node->errorMessage) {
-        errorMessageName = id(node->errorMessage.get());
-        frame->variables[errorMessageName] = e.getMessage();
-      }
+  if (error && !node->catchBody.empty()) {
+    k_string errorTypeName;
+    k_string errorMessageName;
+    if (node->errorType) {
+      errorTypeName = id(node->errorType.get());
+      frame->variables[errorTypeName] = error->getError();
+    }
 
-      for (const auto& stmt : node->catchBody) {
-        interpret(stmt.get());
-      }
+    if (node->errorMessage) {
+      errorMessageName = id(node->errorMessage.get());
+      frame->variables[errorMessageName] = error->getMessage();
+    }
 
+    auto eraseErrorVariables = [&]() {
       if (node->errorType) {
         frame->variables.erase(errorTypeName);
       }
@@ -1474,57 +1464,75 @@ k_value KInterpreter::visit(const TryNode* node) {
       if (node->errorMessage) {
         frame->variables.erase(errorMessageName);
       }
+    };
+
+    // An error thrown out of the catch body still runs the finally block,
+    // and is dropped if the finally block completes abruptly itself.
+    try {
+      executeBlock(node->catchBody, *frame);
+    } catch (const KiwiError&) {
+      eraseErrorVariables();
+      executeFinally(node, *frame);
+      if (frame->isAbrupt()) {
+        return {};
+      }
+      throw;
     }
-  }
 
-  if (!node->finallyBody.empty()) {
-    for (const auto& stmt : node->finallyBody) {
-      interpret(stmt.get());
-    }
+    eraseErrorVariables();
   }
 
+  executeFinally(node, *frame);
   return {};
 }
 
+/// @brief Runs a finally block. It runs after a `return`, `break` or `next`
+/// too, which then carries on unless the finally block completes abruptly
+/// itself.
+void KInterpreter::executeFinally(const TryNode* node, CallStackFrame& frame) {
+  if (node->finallyBody.empty()) {
+    return;
+  }
+
+  auto completion = frame.completion;
+  frame.completion = Completion::Normal;
+  executeBlock(node->finallyBody, frame);
+
+  if (!frame.isAbrupt()) {
+    frame.completion = completion;
+  }
+}
+
 k_value KInterpreter::visit(const LambdaCallNode* node) {
   auto lambdaName =
       std::get<k_lambda>(interpret(node->lambdaNode.get()))->identifier;
+  ProfilerScope profilerScope(node->token, "<lambda>");
+  TraceSpan traceSpan("call", "<lambda>",
+                      TraceRecorder::getCallThresholdNanos());
+  RuntimeStats::increment(RuntimeCounter::LambdaCalls);
   auto lambdaFrame = createFrame();
-  k_value result;
-
-  try {
-    std::vector<std::unique_ptr<ASTNode>> args;
-    result = callLambda(lambdaFrame, node->token, lambdaName, node->arguments);
-    dropFrame();
-  } catch (const KiwiError& e) {
-    dropFrame();
-    throw;
-  }
-
-  return result;
+  return callLambda(lambdaFrame, node->token, lambdaName, node->arguments);
 }
 
 k_value KInterpreter::visit(const LambdaNode* node) {
   std::vector<std::pair<std::string, k_value>> parameters;
-  std::unordered_set<std::string> defaultParameters;
+  size_t requiredArity = 0;
   auto tmpId = InterpHelper::getTemporaryId();
 
   parameters.reserve(node->parameters.size());
   for (const auto& pair : node->parameters) {
-    auto paramName = pair.first;
     k_value paramValue = {};
     if (pair.second) {
       paramValue = interpret(pair.second.get());
-      defaultParameters.emplace(paramName);
+    } else {
+      requiredArity = parameters.size() + 1;
     }
 
-    std::pair<std::string, k_value> param(paramName, paramValue);
-    parameters.emplace_back(param);
+    parameters.emplace_back(pair.first, paramValue);
   }
 
   auto lambda = std::make_unique<KLambda>(node);
-  lambda->parameters = parameters;
-  lambda->defaultParameters = defaultParameters;
+  lambda->setParameters(std::move(parameters), requiredArity);
   lambdas[tmpId] = std::move(lambda);
   lambdaTable[tmpId] = tmpId;
 
@@ -1536,11 +1544,15 @@ k_value KInterpreter::visit(const ClassNode* node) {
   auto clazz = std::make_unique<KClass>();
   clazz->name = className;
 
+  const KClass* base = nullptr;
+
   if (!node->baseClass.empty()) {
     clazz->baseClass = node->baseClass;
-    if (classes.find(clazz->baseClass) == classes.end()) {
+    auto it = classes.find(clazz->baseClass);
+    if (it == classes.end()) {
       throw ClassUndefinedError(node->token, clazz->baseClass);
     }
+    base = it->second.get();
   }
 
   classStack.push(className);
@@ -1557,13 +1569,50 @@ k_value KInterpreter::visit(const ClassNode* node) {
     }
   }
 
-  classes[className] = std::move(clazz);
+  clazz->finalize(base);
+
+  auto& entry = classes[className];
+  if (entry) {
+    retiredClasses.push_back(std::move(entry));
+  }
+  entry = std::move(clazz);
   classStack.pop();
   methods.clear();
 
+  rebuildSubclasses(className);
+
   return {};
 }
 
+/// @brief Rebuilds the method tables of every class derived from a class
+/// that was just defined, since they copied the table of the class it
+/// replaced.
+void KInterpreter::rebuildSubclasses(const k_string& className) {
+  std::vector<k_string> pending = {className};
+  std::unordered_set<k_string> rebuilt = {className};
+
+  while (!pending.empty()) {
+    auto baseName = pending.back();
+    pending.pop_back();
+    const auto* base = classes[baseName].get();
+
+    for (auto& entry : classes) {
+      auto& clazz = entry.second;
+      if (clazz->baseClass != baseName) {
+        continue;
+      }
+
+      // A class redefined to extend its own subclass would loop forever.
+      if (!rebuilt.insert(entry.first).second) {
+        continue;
+      }
+
+      clazz->finalize(base);
+      pending.push_back(entry.first);
+    }
+  }
+}
+
 k_value KInterpreter::visit(const FunctionDeclarationNode* node) {
   auto name = node->name;
 
@@ -1583,24 +1632,23 @@ k_value KInterpreter::visit(const FunctionDeclarationNode* node) {
 std::unique_ptr<KFunction> KInterpreter::createFunction(
     const FunctionDeclarationNode* node, const std::string& name) {
   std::vector<std::pair<std::string, k_value>> parameters;
-  std::unordered_set<std::string> defaultParameters;
+  size_t requiredArity = 0;
 
   parameters.reserve(node->parameters.size());
 
   for (const auto& pair : node->parameters) {
-    auto paramName = pair.first;
     k_value paramValue = {};
     if (pair.second) {
       paramValue = interpret(pair.second.get());
-      defaultParameters.emplace(paramName);
+    } else {
+      requiredArity = parameters.size() + 1;
     }
-    parameters.emplace_back(paramName, paramValue);
+    parameters.emplace_back(pair.first, paramValue);
   }
 
   auto function = std::make_unique<KFunction>(node);
   function->name = name;
-  function->parameters = parameters;
-  function->defaultParameters = defaultParameters;
+  function->setParameters(std::move(parameters), requiredArity);
   function->isPrivate = node->isPrivate;
   function->isStatic = node->isStatic;
 
@@ -1608,104 +1656,47 @@ std::unique_ptr<KFunction> KInterpreter::createFunction(
 }
 
 k_value KInterpreter::visit(const FunctionCallNode* node) {
-  auto callableType = getCallable(node->token, node->functionName);
+  auto callableType =
+      getCallable(node->token, node->functionName, node->methodId);
   k_value result;
 
   if (callableType == KCallableType::Builtin) {
     return callBuiltinMethod(node);
   }
 
+  ProfilerScope profilerScope(node->token, node->functionName);
+  TraceSpan traceSpan("call", node->functionName,
+                      TraceRecorder::getCallThresholdNanos());
   auto functionFrame = createFrame();
 
-  try {
-    if (callableType == KCallableType::Method) {
-      auto frame = callStack.top();
-      if (!frame->inObjectContext()) {
-        throw InvalidContextError(node->token);
-      }
-
-      auto& obj = frame->getObjectContext();
-      auto& clazz = classes[obj->className];
-      auto& clazzMethods = clazz->methods;
-
-      const auto& func = clazzMethods[node->functionName];
-      auto defaultParameters = func->defaultParameters;
-
-      for (size_t i = 0; i < func->parameters.size(); ++i) {
-        const auto& param = func->parameters[i];
-        k_value argValue = {};
-        if (i < node->arguments.size()) {
-          const auto& arg = node->arguments[i];
-          argValue = interpret(arg.get());
-        } else if (defaultParameters.find(param.first) !=
-                   defaultParameters.end()) {
-          argValue = param.second;
-        } else {
-          throw ParameterCountMismatchError(node->token, node->functionName);
-        }
-
-        if (std::holds_alternative<k_lambda>(argValue)) {
-          auto lambdaId = std::get<k_lambda>(argValue)->identifier;
-          lambdaTable[param.first] = lambdaId;
-        } else {
-          functionFrame->variables[param.first] = argValue;
-        }
-      }
-
-      callStack.push(functionFrame);
-
-      const auto& decl = func->getBody();
-      for (const auto& stmt : decl) {
-        result = interpret(stmt.get());
-        if (functionFrame->isFlagSet(FrameFlags::Return)) {
-          result = functionFrame->returnValue;
-          break;
-        }
-      }
-    } else if (callableType == KCallableType::Function) {
-      const auto& func = functions[node->functionName];
-      auto defaultParameters = func->defaultParameters;
-
-      for (size_t i = 0; i < func->parameters.size(); ++i) {
-        const auto& param = func->parameters[i];
-        k_value argValue = {};
-        if (i < node->arguments.size()) {
-          const auto& arg = node->arguments[i];
-          argValue = interpret(arg.get());
-        } else if (defaultParameters.find(param.first) !=
-                   defaultParameters.end()) {
-          argValue = param.second;
-        } else {
-          throw ParameterCountMismatchError(node->token, node->functionName);
-        }
-
-        if (std::holds_alternative<k_lambda>(argValue)) {
-          auto lambdaId = std::get<k_lambda>(argValue)->identifier;
-          lambdaTable[param.first] = lambdaId;
-        } else {
-          functionFrame->variables[param.first] = argValue;
-        }
-      }
-
-      callStack.push(functionFrame);
-
-      const auto& decl = func->getBody();
-      for (const auto& stmt : decl) {
-        result = interpret(stmt.get());
-        if (functionFrame->isFlagSet(FrameFlags::Return)) {
-          result = functionFrame->returnValue;
-          break;
-        }
-      }
-    } else if (callableType == KCallableType::Lambda) {
-      result = callLambda(functionFrame, node->token, node->functionName,
-                          node->arguments);
+  if (callableType == KCallableType::Method) {
+    RuntimeStats::increment(RuntimeCounter::MethodCalls);
+    auto frame = callStack.top();
+    if (!frame->inObjectContext()) {
+      throw InvalidContextError(node->token);
     }
 
-    dropFrame();
-  } catch (const KiwiError& e) {
-    dropFrame();
-    throw;
+    auto& obj = frame->getObjectContext();
+    const auto* func = classes[obj->className]->findMethod(node->methodId);
+    bindArguments(*func, *functionFrame, node->arguments, node->token,
+                  node->functionName);
+
+    pushFrame(functionFrame, node->token);
+    FrameScope frameScope(*this);
+    result = executeFunctionBody(*func);
+  } else if (callableType == KCallableType::Function) {
+    RuntimeStats::increment(RuntimeCounter::FunctionCalls);
+    const auto& func = functions[node->functionName];
+    bindArguments(*func, *functionFrame, node->arguments, node->token,
+                  node->functionName);
+
+    pushFrame(functionFrame, node->token);
+    FrameScope frameScope(*this);
+    result = executeFunctionBody(*func);
+  } else if (callableType == KCallableType::Lambda) {
+    RuntimeStats::increment(RuntimeCounter::LambdaCalls);
+    result = callLambda(functionFrame, node->token, node->functionName,
+                        node->arguments);
   }
 
   return result;
@@ -1725,44 +1716,50 @@ k_value KInterpreter::callLambda(
   }
 
   const auto& func = lambdas[targetLambda];
-  auto defaultParameters = func->defaultParameters;
-
-  for (size_t i = 0; i < func->parameters.size(); ++i) {
-    const auto& param = func->parameters[i];
-    k_value argValue = {};
-    if (i < arguments.size()) {
-      const auto& arg = arguments[i];
-      argValue = interpret(arg.get());
-    } else if (defaultParameters.find(param.first) != defaultParameters.end()) {
-      argValue = param.second;
-    } else {
-      throw ParameterCountMismatchError(token, targetLambda);
-    }
+  bindArguments(*func, *lambdaFrame, arguments, token, targetLambda);
 
-    if (std::holds_alternative<k_lambda>(argValue)) {
-      auto lambdaId = std::get<k_lambda>(argValue)->identifier;
-      lambdaTable[param.first] = lambdaId;
-    } else {
-      lambdaFrame->variables[param.first] = argValue;
-    }
+  pushFrame(lambdaFrame, token);
+  FrameScope frameScope(*this);
+
+  result = executeBlock(func->getBody(), *lambdaFrame);
+  if (lambdaFrame->completion == Completion::Return) {
+    result = lambdaFrame->returnValue;
   }
 
-  callStack.push(lambdaFrame);
+  return result;
+}
 
-  const auto& decl = func->getBody();
-  for (const auto& stmt : decl) {
-    result = interpret(stmt.get());
-    if (lambdaFrame->isFlagSet(FrameFlags::Return)) {
-      result = lambdaFrame->returnValue;
-      break;
-    }
+void KInterpreter::bindArguments(
+    const KCallable& callable, CallStackFrame& frame,
+    const std::vector<std::unique_ptr<ASTNode>>& arguments, const Token& token,
+    const std::string& name) {
+  const auto& call = callable.call;
+  auto passed = std::min(arguments.size(), call.arity);
+
+  if (passed < call.requiredArity) {
+    throw ParameterCountMismatchError(token, name);
   }
 
-  return result;
+  // Arguments past the last parameter are not evaluated.
+  for (size_t i = 0; i < call.arity; ++i) {
+    const auto& param = callable.parameters[i];
+    bindParameter(param, i < passed ? interpret(arguments[i].get()) : param.second,
+                  frame);
+  }
+}
+
+void KInterpreter::bindParameter(const std::pair<k_string, k_value>& param,
+                                 k_value argValue, CallStackFrame& frame) {
+  if (std::holds_alternative<k_lambda>(argValue)) {
+    lambdaTable[param.first] = std::get<k_lambda>(argValue)->identifier;
+  } else {
+    frame.variables[param.first] = std::move(argValue);
+  }
 }
 
 KCallableType KInterpreter::getCallable(const Token& token,
-                                        const std::string& name) const {
+                                        const std::string& name,
+                                        int methodId) const {
   if (functions.find(name) != functions.end()) {
     return KCallableType::Function;
   } else if (lambdas.find(name) != lambdas.end()) {
@@ -1779,9 +1776,8 @@ KCallableType KInterpreter::getCallable(const Token& token,
 
   if (frame->inObjectContext()) {
     auto& obj = frame->getObjectContext();
-    auto& clazz = classes[obj->className];
-    auto& clazzMethods = clazz->methods;
-    if (clazzMethods.find(name) != clazzMethods.end()) {
+    auto it = classes.find(obj->className);
+    if (it != classes.end() && it->second->findMethod(methodId)) {
       return KCallableType::Method;
     }
   }
@@ -1790,61 +1786,127 @@ KCallableType KInterpreter::getCallable(const Token& token,
 }
 
 k_value KInterpreter::callFunction(
-    const std::unique_ptr<KFunction>& function,
+    const KFunction& function,
     const std::vector<std::unique_ptr<ASTNode>>& arguments, const Token& token,
     const std::string& functionName) {
-  auto defaultParameters = function->defaultParameters;
   auto functionFrame = createFrame();
+  bindArguments(function, *functionFrame, arguments, token, functionName);
 
-  for (size_t i = 0; i < function->parameters.size(); ++i) {
-    const auto& param = function->parameters[i];
-    k_value argValue = {};
-    if (i < arguments.size()) {
-      const auto& arg = arguments[i];
-      argValue = interpret(arg.get());
-    } else if (defaultParameters.find(param.first) != defaultParameters.end()) {
-      argValue = param.second;
-    } else {
-      throw ParameterCountMismatchError(token, functionName);
-    }
+  pushFrame(functionFrame, token);
+  FrameScope frameScope(*this);
 
-    if (std::holds_alternative<k_lambda>(argValue)) {
-      auto lambdaId = std::get<k_lambda>(argValue)->identifier;
-      lambdaTable[param.first] = lambdaId;
-    } else {
-      functionFrame->variables[param.first] = argValue;
+  return executeFunctionBody(function);
+}
+
+/// @brief Runs a function body in the frame on top of the stack. A tail
+/// call made by the body rebinds the frame and runs the callee's body in
+/// its place, so tail recursion runs in constant stack space.
+k_value KInterpreter::executeFunctionBody(const KFunction& function) {
+  const auto frame = callStack.top();
+  const auto* current = &function;
+
+  while (true) {
+    auto result = executeBlock(current->decl->body, *frame);
+
+    if (frame->completion != Completion::TailCall) {
+      return frame->completion == Completion::Return ? frame->returnValue
+                                                     : result;
     }
-  }
 
-  callStack.push(functionFrame);
+    frame->completion = Completion::Normal;
 
-  k_value result;
+    current = tailCall.function;
+    auto arguments = std::move(tailCall.arguments);
+    tailCall.function = nullptr;
 
-  try {
-    result = executeFunctionBody(function);
-    dropFrame();
-  } catch (const KiwiError& e) {
-    dropFrame();
-    throw;
+    for (size_t i = 0; i < current->call.arity; ++i) {
+      const auto& param = current->parameters[i];
+      bindParameter(param, i < arguments.size() ? std::move(arguments[i])
+                                                : param.second,
+                    *frame);
+    }
   }
-
-  return result;
 }
 
-k_value KInterpreter::executeFunctionBody(
-    const std::unique_ptr<KFunction>& function) {
+/// @brief Runs a block of statements, stopping after one that completes
+/// abruptly.
+/// @return The value of the last statement run.
+k_value KInterpreter::executeBlock(
+    const std::vector<std::unique_ptr<ASTNode>>& block, CallStackFrame& frame) {
   k_value result;
-  const auto& decl = *function->decl;
-  for (const auto& stmt : decl.body) {
+  for (const auto& stmt : block) {
     result = interpret(stmt.get());
-    if (callStack.top()->isFlagSet(FrameFlags::Return)) {
-      result = callStack.top()->returnValue;
+    if (frame.isAbrupt()) {
       break;
     }
   }
   return result;
 }
 
+/// @brief Runs one pass of a loop body and settles a `break` or `next`.
+/// @return Whether the loop should stop.
+bool KInterpreter::executeLoopBody(
+    const std::vector<std::unique_ptr<ASTNode>>& body, CallStackFrame& frame,
+    k_value& result) {
+  result = executeBlock(body, frame);
+
+  switch (frame.completion) {
+    case Completion::Normal:
+      return false;
+
+    case Completion::Next:
+      frame.completion = Completion::Normal;
+      return false;
+
+    case Completion::Break:
+      frame.completion = Completion::Normal;
+      return true;
+
+    default:
+      return true;
+  }
+}
+
+/// @brief Evaluates the arguments of a call in tail position and records
+/// it for the running function body, if the callee is a function or a
+/// method of the current object.
+bool KInterpreter::prepareTailCall(const FunctionCallNode* node) {
+  const KFunction* callee = nullptr;
+  auto callableType =
+      getCallable(node->token, node->functionName, node->methodId);
+
+  if (callableType == KCallableType::Function) {
+    RuntimeStats::increment(RuntimeCounter::FunctionCalls);
+    callee = functions[node->functionName].get();
+  } else if (callableType == KCallableType::Method) {
+    RuntimeStats::increment(RuntimeCounter::MethodCalls);
+    const auto& obj = callStack.top()->getObjectContext();
+    callee = classes[obj->className]->findMethod(node->methodId);
+  } else {
+    return false;
+  }
+
+  const auto& call = callee->call;
+  auto passed = std::min(node->arguments.size(), call.arity);
+
+  if (passed < call.requiredArity) {
+    throw ParameterCountMismatchError(node->token, node->functionName);
+  }
+
+  // Every argument is evaluated before any parameter is rebound, since the
+  // arguments may read the parameters of the returning call.
+  std::vector<k_value> arguments;
+  arguments.reserve(passed);
+  for (size_t i = 0; i < passed; ++i) {
+    arguments.emplace_back(interpret(node->arguments[i].get()));
+  }
+
+  RuntimeStats::increment(RuntimeCounter::TailCalls);
+  tailCall.function = callee;
+  tailCall.arguments = std::move(arguments);
+  return true;
+}
+
 k_value KInterpreter::visit(const MethodCallNode* node) {
   auto object = interpret(node->object.get());
 
@@ -1875,71 +1937,23 @@ std::vector<k_value> KInterpreter::getMethodCallArguments(
   return arguments;
 }
 
-k_value KInterpreter::callObjectBaseMethod(const MethodCallNode* node,
-                                           const std::shared_ptr<Object>& obj,
-                                           const k_string& baseClass,
-                                           const k_string& methodName) {
-  const auto& clazz = classes[baseClass];
-  auto& function = clazz->methods[methodName];
-  bool isCtor = methodName == Keywords.New;
-
-  auto& frame = callStack.top();
-  auto objContext = obj;
-  bool contextSwitch = false;
-
-  if (frame->inObjectContext()) {
-    objContext = frame->getObjectContext();
-    contextSwitch = true;
-  }
-
-  frame->setObjectContext(obj);
-
-  if (!function) {
-    throw UnimplementedMethodError(node->token, obj->className, methodName);
-  }
-
-  if (function->isPrivate) {
-    throw InvalidContextError(node->token,
-                              "Cannot invoke private method outside of class.");
-  }
-
-  auto result =
-      callFunction(function, node->arguments, node->token, methodName);
-
-  if (contextSwitch) {
-    frame->setObjectContext(objContext);
-  }
-
-  if (isCtor) {
-    return obj;
-  }
-
-  return result;
-}
-
 k_value KInterpreter::callObjectMethod(const MethodCallNode* node,
                                        const std::shared_ptr<Object>& obj) {
-  const auto& clazz = classes[obj->className];
-  auto methodName = node->methodName;
-
-  if (clazz->methods.find(methodName) == clazz->methods.end()) {
-    auto baseClass = clazz->baseClass;
-
-    if (baseClass.empty()) {
-      throw UnimplementedMethodError(node->token, obj->className, methodName);
-    }
-
-    if (classes.find(baseClass) == classes.end()) {
-      throw ClassUndefinedError(node->token, baseClass);
-    }
-
-    return callObjectBaseMethod(node, obj, baseClass, methodName);
+  auto it = classes.find(obj->className);
+  if (it == classes.end()) {
+    throw ClassUndefinedError(node->token, obj->className);
   }
 
-  auto& function = clazz->methods[methodName];
-  bool isCtor = methodName == Keywords.New;
+  const auto& clazz = it->second;
+  const auto& methodName = node->methodName;
+  const auto* function = clazz->findMethod(node->methodId);
+  bool isCtor = node->methodId == MethodIds::getCtor();
+  ProfilerScope profilerScope(node->token, clazz->name, methodName);
+  TraceSpan traceSpan("call", clazz->name, methodName,
+                      TraceRecorder::getCallThresholdNanos());
+  RuntimeStats::increment(RuntimeCounter::MethodCalls);
 
-  auto& frame = callStack.top();
+  auto frame = callStack.top();
   auto objContext = obj;
   bool contextSwitch = false;
 
@@ -1960,7 +1974,7 @@ k_value KInterpreter::callObjectMethod(const MethodCallNode* node,
   }
 
   auto result =
-      callFunction(function, node->arguments, node->token, methodName);
+      callFunction(*function, node->arguments, node->token, methodName);
 
   if (contextSwitch) {
     frame->setObjectContext(objContext);
@@ -1975,14 +1989,23 @@ k_value KInterpreter::callObjectMethod(const MethodCallNode* node,
 
 k_value KInterpreter::callClassMethod(const MethodCallNode* node,
                                       const k_class& clazz) {
-  auto methodName = node->methodName;
-  auto& frame = callStack.top();
+  const auto& methodName = node->methodName;
+  auto frame = callStack.top();
   const auto& kclass = classes[clazz->identifier];
-  auto& function = kclass->methods[methodName];
+  const auto* function = kclass->findMethod(node->methodId);
   k_object obj = std::make_shared<Object>();
-  bool isCtor = methodName == Keywords.New;
+  bool isCtor = node->methodId == MethodIds::getCtor();
+  ProfilerScope profilerScope(node->token, kclass->name, methodName);
+  TraceSpan traceSpan("call", kclass->name, methodName,
+                      TraceRecorder::getCallThresholdNanos());
+  RuntimeStats::increment(RuntimeCounter::MethodCalls);
+
+  if (!function) {
+    if (!isCtor) {
+      throw UnimplementedMethodError(node->token, kclass->name, methodName);
+    }
 
-  if (!function && isCtor) {
+    obj->className = clazz->identifier;
     return obj;  // default constructor
   }
 
@@ -1997,7 +2020,7 @@ k_value KInterpreter::callClassMethod(const MethodCallNode* node,
   }
 
   auto result =
-      callFunction(function, node->arguments, node->token, methodName);
+      callFunction(*function, node->arguments, node->token, methodName);
 
   if (isCtor) {
     frame->clearFlag(FrameFlags::InObject);
@@ -2047,6 +2070,13 @@ k_value KInterpreter::interpretWebServerBuiltin(const Token& token,
 void KInterpreter::handleWebServerRequest(int webhookID, k_hash requestHash,
                                           k_string& redirect, k_string& content,
                                           k_string& contentType, int& status) {
+  // Handlers run on the server's worker threads, one at a time.
+  std::unique_lock<std::mutex> lock(interpreterMutex, std::defer_lock);
+  {
+    TraceSpan traceSpan("http", "wait");
+    lock.lock();
+  }
+
   auto webhook = serverHooks[webhookID];
   auto webhookFrame = createFrame();
 
@@ -2059,49 +2089,45 @@ void KInterpreter::handleWebServerRequest(int webhookID, k_hash requestHash,
 
   k_value result;
 
-  try {
-    const auto& decl = lambda->getBody();
-    for (const auto& stmt : decl) {
-      result = interpret(stmt.get());
-      if (webhookFrame->isFlagSet(FrameFlags::Return)) {
-        result = webhookFrame->returnValue;
-        break;
-      }
+  pushFrame(webhookFrame, Token::createEmpty());
+  FrameScope frameScope(*this);
+
+  {
+    TraceSpan traceSpan("http", "handler");
+    result = executeBlock(lambda->getBody(), *webhookFrame);
+    if (webhookFrame->completion == Completion::Return) {
+      result = webhookFrame->returnValue;
     }
+  }
 
-    if (std::holds_alternative<k_hash>(result)) {
-      auto responseHash = std::get<k_hash>(result);
-      if (responseHash->hasKey("content")) {
-        auto responseHashContent = responseHash->get("content");
-        content = Serializer::serialize(responseHashContent);
-      }
+  if (std::holds_alternative<k_hash>(result)) {
+    auto responseHash = std::get<k_hash>(result);
+    if (responseHash->hasKey("content")) {
+      TraceSpan traceSpan("http", "serialize");
+      auto responseHashContent = responseHash->get("content");
+      content = Serializer::serialize(responseHashContent);
+    }
 
-      if (responseHash->hasKey("content-type")) {
-        auto responseHashContent = responseHash->get("content-type");
-        if (std::holds_alternative<k_string>(responseHashContent)) {
-          contentType = std::get<k_string>(responseHashContent);
-        }
+    if (responseHash->hasKey("content-type")) {
+      auto responseHashContent = responseHash->get("content-type");
+      if (std::holds_alternative<k_string>(responseHashContent)) {
+        contentType = std::get<k_string>(responseHashContent);
       }
+    }
 
-      if (responseHash->hasKey("status")) {
-        auto responseHashContent = responseHash->get("status");
-        if (std::holds_alternative<k_int>(responseHashContent)) {
-          status = static_cast<int>(std::get<k_int>(responseHashContent));
-        }
+    if (responseHash->hasKey("status")) {
+      auto responseHashContent = responseHash->get("status");
+      if (std::holds_alternative<k_int>(responseHashContent)) {
+        status = static_cast<int>(std::get<k_int>(responseHashContent));
       }
+    }
 
-      if (responseHash->hasKey("redirect")) {
-        auto responseHashContent = responseHash->get("redirect");
-        if (std::holds_alternative<k_string>(responseHashContent)) {
-          redirect = std::get<k_string>(responseHashContent);
-        }
+    if (responseHash->hasKey("redirect")) {
+      auto responseHashContent = responseHash->get("redirect");
+      if (std::holds_alternative<k_string>(responseHashContent)) {
+        redirect = std::get<k_string>(responseHashContent);
       }
     }
-
-    dropFrame();
-  } catch (const KiwiError& e) {
-    dropFrame();
-    throw;
   }
 }
 
@@ -2140,7 +2166,14 @@ k_value KInterpreter::interpretWebServerGet(const Token& token,
   for (const auto& endpoint : endpointList) {
     server.Get(endpoint, [this, webhookID](const httplib::Request& req,
                                            httplib::Response& res) {
-      auto requestHash = InterpHelper::getWebServerRequestHash(req);
+      TraceSpan requestSpan("http", req.method + " " + req.path);
+      k_hash requestHash;
+      {
+        TraceSpan traceSpan("http", "receive");
+        // Built before the interpreter lock is taken, so left untracked.
+        CycleCollector::UntrackedScope untrackedScope;
+        requestHash = InterpHelper::getWebServerRequestHash(req);
+      }
 
       k_string content, redirect;
       k_string contentType = "text/plain";
@@ -2168,7 +2201,14 @@ k_value KInterpreter::interpretWebServerPost(const Token& token,
   for (const auto& endpoint : endpointList) {
     server.Post(endpoint, [this, webhookID](const httplib::Request& req,
                                             httplib::Response& res) {
-      auto requestHash = InterpHelper::getWebServerRequestHash(req);
+      TraceSpan requestSpan("http", req.method + " " + req.path);
+      k_hash requestHash;
+      {
+        TraceSpan traceSpan("http", "receive");
+        // Built before the interpreter lock is taken, so left untracked.
+        CycleCollector::UntrackedScope untrackedScope;
+        requestHash = InterpHelper::getWebServerRequestHash(req);
+      }
 
       k_string content, redirect;
       k_string contentType = "text/plain";
@@ -2197,6 +2237,25 @@ k_value KInterpreter::interpretWebServerListen(const Token& token,
   auto host = get_string(token, args.at(0));
   auto port = get_integer(token, args.at(1));
 
+  // Responses are written in several small segments. Without this, Nagle's
+  // algorithm holds each one back until the client's delayed ACK, which adds
+  // about 40ms to every request on a kept-alive connection.
+  server.set_tcp_nodelay(true);
+
+  if (TraceRecorder::isEnabled()) {
+    // The server writes the response after the handler returns.
+    static thread_local TraceRecorder::Clock::time_point writeStart;
+
+    server.set_post_routing_handler(
+        [](const httplib::Request&, httplib::Response&) {
+          writeStart = TraceRecorder::Clock::now();
+        });
+    server.set_logger([](const httplib::Request&, const httplib::Response&) {
+      TraceRecorder::getInstance().record("http", "write", writeStart,
+                                          TraceRecorder::Clock::now());
+    });
+  }
+
   server.listen(host, static_cast<int>(port));
 
   auto hash = std::make_shared<Hash>();
@@ -2227,6 +2286,30 @@ k_value KInterpreter::interpretWebServerPublic(const Token& token,
 k_value KInterpreter::interpretReflectorBuiltin(const Token& token,
                                                 const KName& builtin,
                                                 std::vector<k_value>& args) {
+  if (builtin == KName::Builtin_Reflector_MemStats) {
+    if (args.size() != 0) {
+      throw BuiltinUnexpectedArgumentError(token, ReflectorBuiltins.MemStats);
+    }
+
+    return getMemoryStats();
+  }
+
+  if (builtin == KName::Builtin_Reflector_RtStats) {
+    if (args.size() != 0) {
+      throw BuiltinUnexpectedArgumentError(token, ReflectorBuiltins.RtStats);
+    }
+
+    return getRuntimeStats();
+  }
+
+  if (builtin == KName::Builtin_Reflector_Collect) {
+    if (args.size() != 0) {
+      throw BuiltinUnexpectedArgumentError(token, ReflectorBuiltins.Collect);
+    }
+
+    return static_cast<k_int>(CycleCollector::collect().freed);
+  }
+
   if (builtin != KName::Builtin_Reflector_RList) {
     throw InvalidOperationError(token, "Come back later.");
   }
@@ -2258,10 +2341,8 @@ k_value KInterpreter::interpretReflectorBuiltin(const Token& token,
     rlistClasses->elements.emplace_back(c.first);
   }
 
-  std::stack<std::shared_ptr<CallStackFrame>> tempStack(callStack);
-
-  while (!tempStack.empty()) {
-    const auto& outerFrame = tempStack.top();
+  for (auto it = callStack.end(); it != callStack.begin();) {
+    const auto& outerFrame = *--it;
     const auto& frameVariables = outerFrame->variables;
 
     auto rlistStackFrame = std::make_shared<Hash>();
@@ -2280,8 +2361,6 @@ k_value KInterpreter::interpretReflectorBuiltin(const Token& token,
 
     rlistStackFrame->add("variables", rlistStackFrameVariables);
     rlistStack->elements.emplace_back(rlistStackFrame);
-
-    tempStack.pop();
   }
 
   sort_list(*rlistPackages);
@@ -2297,6 +2376,180 @@ k_value KInterpreter::interpretReflectorBuiltin(const Token& token,
   return rlist;
 }
 
+k_hash KInterpreter::getMemoryStats() {
+  // Snapshot the counters before the result itself allocates.
+  std::vector<std::array<int64_t, 3>> counts;
+  for (int i = 0; i < MemoryStats::KindCount; ++i) {
+    auto kind = static_cast<MemoryKind>(i);
+    counts.push_back({MemoryStats::getLive(kind), MemoryStats::getPeak(kind),
+                      MemoryStats::getTotal(kind)});
+  }
+
+  MemoryMeter meter;
+  for (const auto& frame : callStack) {
+    meter.addFrame(*frame);
+  }
+
+  for (const auto& pair : functions) {
+    meter.addCallable(*pair.second);
+  }
+
+  for (const auto& pair : lambdas) {
+    meter.addCallable(*pair.second);
+  }
+
+  for (const auto& pair : classes) {
+    for (const auto& method : pair.second->methods) {
+      if (method.second) {
+        meter.addCallable(*method.second);
+      }
+    }
+  }
+
+  auto stats = std::make_shared<Hash>();
+
+  for (int i = 0; i < MemoryStats::KindCount; ++i) {
+    auto kind = static_cast<MemoryKind>(i);
+    const auto& usage = meter.getUsage(kind);
+    auto kindStats = std::make_shared<Hash>();
+    kindStats->add("live", static_cast<k_int>(counts[i][0]));
+    kindStats->add("peak", static_cast<k_int>(counts[i][1]));
+    kindStats->add("allocated", static_cast<k_int>(counts[i][2]));
+    kindStats->add("reachable", static_cast<k_int>(usage.count));
+    kindStats->add("bytes", static_cast<k_int>(usage.bytes));
+    stats->add(MemoryStats::getKindName(kind), kindStats);
+  }
+
+  const auto& stringUsage = meter.getStringUsage();
+  auto stringStats = std::make_shared<Hash>();
+  stringStats->add("reachable", static_cast<k_int>(stringUsage.count));
+  stringStats->add("bytes", static_cast<k_int>(stringUsage.bytes));
+  stats->add("string", stringStats);
+
+  auto tables = std::make_shared<Hash>();
+  tables->add("functions", static_cast<k_int>(functions.size()));
+  tables->add("lambdas", static_cast<k_int>(lambdas.size()));
+  tables->add("lambda_table", static_cast<k_int>(lambdaTable.size()));
+  tables->add("classes", static_cast<k_int>(classes.size()));
+  tables->add("packages", static_cast<k_int>(packages.size()));
+  stats->add("tables", tables);
+
+  auto sites = std::make_shared<List>();
+  auto& registry = FileRegistry::getInstance();
+
+  for (const auto& site : MemoryStats::getSites()) {
+    auto siteHash = std::make_shared<Hash>();
+    siteHash->add("kind", k_string(MemoryStats::getKindName(site.kind)));
+    siteHash->add("file", site.file < 0 ? k_string("<native>")
+                                        : registry.getFilePath(site.file));
+    siteHash->add("line", static_cast<k_int>(site.line + 1));
+    siteHash->add("count", static_cast<k_int>(site.count));
+    sites->elements.emplace_back(siteHash);
+  }
+
+  stats->add("sites", sites);
+
+  return stats;
+}
+
+k_hash KInterpreter::getRuntimeStats() {
+  auto getCount = [](RuntimeCounter counter) {
+    return static_cast<k_int>(RuntimeStats::get(counter));
+  };
+  // Count allocations before the result itself allocates.
+  int64_t allocations = 0;
+  for (int i = 0; i < MemoryStats::KindCount; ++i) {
+    allocations += MemoryStats::getTotal(static_cast<MemoryKind>(i));
+  }
+
+  auto stats = std::make_shared<Hash>();
+
+  stats->add("uptime_ms", RuntimeStats::getUptimeNanos() / 1e6);
+  stats->add("nodes", getCount(RuntimeCounter::Nodes));
+  stats->add("parsed_nodes", getCount(RuntimeCounter::ParsedNodes));
+  stats->add("function_calls", getCount(RuntimeCounter::FunctionCalls));
+  stats->add("method_calls", getCount(RuntimeCounter::MethodCalls));
+  stats->add("lambda_calls", getCount(RuntimeCounter::LambdaCalls));
+  stats->add("tail_calls", getCount(RuntimeCounter::TailCalls));
+  stats->add("frames", getCount(RuntimeCounter::Frames));
+  stats->add("allocations", static_cast<k_int>(allocations));
+  stats->add("peak_rss_kb", Sys::getPeakResidentKilobytes());
+  stats->add("stack_depth", static_cast<k_int>(callStack.size()));
+  stats->add("max_stack_depth",
+             static_cast<k_int>(RuntimeStats::getMaxDepth()));
+  stats->add("lambdas", static_cast<k_int>(lambdas.size()));
+  stats->add("lambda_table", static_cast<k_int>(lambdaTable.size()));
+  stats->add("regex_compiles", getCount(RuntimeCounter::RegexCompiles));
+  stats->add("imports", getCount(RuntimeCounter::Imports));
+  stats->add("serializations", getCount(RuntimeCounter::Serializations));
+  stats->add("serialize_ms",
+             RuntimeStats::get(RuntimeCounter::SerializeNanos) / 1e6);
+  stats->add("gc_tracked", static_cast<k_int>(CycleCollector::getTracked()));
+  stats->add("gc_collections", getCount(RuntimeCounter::Collections));
+  stats->add("gc_freed", getCount(RuntimeCounter::CollectedValues));
+  stats->add("gc_pause_ms",
+             RuntimeStats::get(RuntimeCounter::CollectNanos) / 1e6);
+  stats->add("gc_max_pause_ms", RuntimeStats::getMaxCollectNanos() / 1e6);
+
+  return stats;
+}
+
+void KInterpreter::printMemoryReport() {
+  const size_t MaxSites = 20;
+  auto stats = getMemoryStats();
+  auto getInt = [](const k_hash& hash, const k_string& key) {
+    return std::get<k_int>(hash->get(key));
+  };
+
+  std::cerr << std::endl
+            << "Memory report" << std::endl
+            << "  " << std::left << std::setw(8) << "Kind" << std::right
+            << std::setw(12) << "Live" << std::setw(12) << "Peak"
+            << std::setw(14) << "Allocated" << std::setw(12) << "Reachable"
+            << std::setw(14) << "Bytes" << std::endl;
+
+  for (int i = 0; i < MemoryStats::KindCount; ++i) {
+    auto name = MemoryStats::getKindName(static_cast<MemoryKind>(i));
+    auto kindStats = std::get<k_hash>(stats->get(name));
+    std::cerr << "  " << std::left << std::setw(8) << name << std::right
+              << std::setw(12) << getInt(kindStats, "live") << std::setw(12)
+              << getInt(kindStats, "peak") << std::setw(14)
+              << getInt(kindStats, "allocated") << std::setw(12)
+              << getInt(kindStats, "reachable") << std::setw(14)
+              << getInt(kindStats, "bytes") << std::endl;
+  }
+
+  auto stringStats = std::get<k_hash>(stats->get("string"));
+  std::cerr << "  " << std::left << std::setw(8) << "string" << std::right
+            << std::setw(50) << getInt(stringStats, "reachable")
+            << std::setw(14) << getInt(stringStats, "bytes") << std::endl;
+
+  auto tables = std::get<k_hash>(stats->get("tables"));
+  std::cerr << std::endl << "  Tables:";
+  for (const auto& key : tables->keys) {
+    std::cerr << " " << key << "=" << getInt(tables, key);
+  }
+  std::cerr << std::endl;
+
+  auto sites = std::get<k_list>(stats->get("sites"))->elements;
+  if (!sites.empty()) {
+    std::cerr << std::endl
+              << "  Allocation sites (1 in " << MemoryStats::getSampleInterval()
+              << " sampled):" << std::endl;
+
+    for (size_t i = 0; i < sites.size() && i < MaxSites; ++i) {
+      auto site = std::get<k_hash>(sites[i]);
+      std::cerr << "  " << std::left << std::setw(8)
+                << std::get<k_string>(site->get("kind")) << std::right
+                << std::setw(12) << getInt(site, "count") << "  "
+                << std::get<k_string>(site->get("file")) << ":"
+                << getInt(site, "line") << std::endl;
+    }
+  }
+
+  std::cerr << std::endl;
+}
+
 k_value KInterpreter::interpolateString(const Token& token,
                                         const k_string& input) {
   Parser parser;
@@ -2450,8 +2703,10 @@ k_value KInterpreter::listSort(const k_list& list) {
 
 k_value KInterpreter::lambdaEach(std::unique_ptr<KLambda>& lambda,
                                  const k_list& list) {
-  auto defaultParameters = lambda->defaultParameters;
   auto frame = callStack.top();
+  // The lambda body runs in this frame, but a `try` around the call must
+  // still see its errors as exceptions.
+  FrameDepthScope tryScope(frame->tryDepth, 0);
 
   k_string valueVariable;
   k_string indexVariable;
@@ -2476,6 +2731,7 @@ k_value KInterpreter::lambdaEach(std::unique_ptr<KLambda>& lambda,
   k_value result;
   const auto& decl = *lambda->decl;
   const auto& elements = list->elements;
+  RuntimeStats::add(RuntimeCounter::LambdaCalls, elements.size());
 
   for (size_t i = 0; i < elements.size(); ++i) {
     frame->variables[valueVariable] = elements.at(i);
@@ -2508,8 +2764,8 @@ k_value KInterpreter::lambdaNone(std::unique_ptr<KLambda>& lambda,
 
 k_value KInterpreter::lambdaMap(std::unique_ptr<KLambda>& lambda,
                                 const k_list& list) {
-  auto defaultParameters = lambda->defaultParameters;
   auto frame = callStack.top();
+  FrameDepthScope tryScope(frame->tryDepth, 0);
 
   k_string mapVariable;
 
@@ -2527,6 +2783,7 @@ k_value KInterpreter::lambdaMap(std::unique_ptr<KLambda>& lambda,
 
   const auto& decl = *lambda->decl;
   const auto& elements = list->elements;
+  RuntimeStats::add(RuntimeCounter::LambdaCalls, elements.size());
   std::vector<k_value> resultList;
 
   for (size_t i = 0; i < elements.size(); ++i) {
@@ -2544,8 +2801,8 @@ k_value KInterpreter::lambdaMap(std::unique_ptr<KLambda>& lambda,
 
 k_value KInterpreter::lambdaReduce(std::unique_ptr<KLambda>& lambda,
                                    k_value accumulator, const k_list& list) {
-  auto defaultParameters = lambda->defaultParameters;
   auto frame = callStack.top();
+  FrameDepthScope tryScope(frame->tryDepth, 0);
 
   k_string accumVariable;
   k_string valueVariable;
@@ -2566,6 +2823,7 @@ k_value KInterpreter::lambdaReduce(std::unique_ptr<KLambda>& lambda,
   }
 
   const auto& elements = list->elements;
+  RuntimeStats::add(RuntimeCounter::LambdaCalls, elements.size());
   const auto& decl = *lambda->decl;
   k_value result;
 
@@ -2587,8 +2845,8 @@ k_value KInterpreter::lambdaReduce(std::unique_ptr<KLambda>& lambda,
 
 k_value KInterpreter::lambdaSelect(std::unique_ptr<KLambda>& lambda,
                                    const k_list& list) {
-  auto defaultParameters = lambda->defaultParameters;
   auto frame = callStack.top();
+  FrameDepthScope tryScope(frame->tryDepth, 0);
 
   k_string valueVariable;
   k_string indexVariable;
@@ -2609,6 +2867,7 @@ k_value KInterpreter::lambdaSelect(std::unique_ptr<KLambda>& lambda,
   k_value result;
   const auto& decl = *lambda->decl;
   const auto& elements = list->elements;
+  RuntimeStats::add(RuntimeCounter::LambdaCalls, elements.size());
   std::vector<k_value> resultList;
 
   for (size_t i = 0; i < elements.size(); ++i) {
@@ -0,0 +1,847 @@
+#ifndef KIWI_MATH_BIGINT_H
+#define KIWI_MATH_BIGINT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bits.h"
+
+/// @brief An arbitrary-precision integer.
+///
+/// The magnitude is stored as base 2^32 limbs, least significant first,
+/// with no leading zero limbs, and the sign separately. Zero has no limbs
+/// and is never negative. Division and remainder truncate toward zero, like
+/// the built-in integer operations.
+class BigInt {
+ public:
+  using Limbs = std::vector<uint32_t>;
+
+  BigInt() {}
+
+  BigInt(int64_t value) {
+    negative = value < 0;
+    // Negate in unsigned arithmetic so the smallest value does not overflow.
+    auto magnitude = negative ? 0 - static_cast<uint64_t>(value)
+                              : static_cast<uint64_t>(value);
+    while (magnitude > 0) {
+      limbs.push_back(static_cast<uint32_t>(magnitude));
+      magnitude >>= 32;
+    }
+  }
+
+  /// @brief Parses an optionally signed string of decimal digits.
+  static bool parse(const std::string& text, BigInt& result) {
+    size_t start = 0;
+    bool isNegative = false;
+    if (!text.empty() && (text[0] == '-' || text[0] == '+')) {
+      isNegative = text[0] == '-';
+      start = 1;
+    }
+
+    if (start == text.size()) {
+      return false;
+    }
+
+    for (auto i = start; i < text.size(); ++i) {
+      if (text[i] < '0' || text[i] > '9') {
+        return false;
+      }
+    }
+
+    std::vector<DecimalPower> powers;
+    result.limbs =
+        parseDigits(text.data() + start, text.size() - start, powers);
+    result.negative = isNegative && !result.limbs.empty();
+    return true;
+  }
+
+  bool isZero() const { return limbs.empty(); }
+  bool isNegative() const { return negative; }
+
+  bool fitsInt64() const {
+    if (limbs.size() > 2) {
+      return false;
+    }
+
+    auto magnitude = getLow64();
+    return negative ? magnitude <= (uint64_t(1) << 63)
+                    : magnitude < (uint64_t(1) << 63);
+  }
+
+  /// @brief Returns the value, which the caller has checked fits.
+  int64_t toInt64() const {
+    auto magnitude = getLow64();
+    return negative ? static_cast<int64_t>(0 - magnitude)
+                    : static_cast<int64_t>(magnitude);
+  }
+
+  double toDouble() const {
+    double result = 0;
+    for (auto it = limbs.rbegin(); it != limbs.rend(); ++it) {
+      result = result * 4294967296.0 + *it;
+    }
+    return negative ? -result : result;
+  }
+
+  /// @brief Converts to decimal.
+  ///
+  /// Large values are split in half by a power of ten, and each half is
+  /// converted on its own, so most of the work is a few large divisions
+  /// rather than one small division per digit group.
+  std::string toString() const {
+    if (limbs.empty()) {
+      return "0";
+    }
+
+    std::string digits;
+    std::vector<DecimalPower> powers;
+    appendDigits(limbs, 0, powers, digits);
+    return negative ? "-" + digits : digits;
+  }
+
+  size_t hash() const {
+    size_t seed = negative ? 1 : 0;
+    for (auto limb : limbs) {
+      seed ^= std::hash<uint32_t>()(limb) + 0x9e3779b9 + (seed << 6) +
+              (seed >> 2);
+    }
+    return seed;
+  }
+
+  static int compare(const BigInt& a, const BigInt& b) {
+    if (a.negative != b.negative) {
+      return a.negative ? -1 : 1;
+    }
+
+    auto order = compareMagnitudes(a.limbs, b.limbs);
+    return a.negative ? -order : order;
+  }
+
+  BigInt operator-() const {
+    BigInt result = *this;
+    result.negative = !negative && !limbs.empty();
+    return result;
+  }
+
+  friend BigInt operator+(const BigInt& a, const BigInt& b) {
+    if (a.negative == b.negative) {
+      return make(addMagnitudes(a.limbs, b.limbs), a.negative);
+    }
+
+    // The signs differ, so subtract the smaller magnitude from the larger.
+    if (compareMagnitudes(a.limbs, b.limbs) >= 0) {
+      return make(subtractMagnitudes(a.limbs, b.limbs), a.negative);
+    }
+    return make(subtractMagnitudes(b.limbs, a.limbs), b.negative);
+  }
+
+  friend BigInt operator-(const BigInt& a, const BigInt& b) { return a + -b; }
+
+  friend BigInt operator*(const BigInt& a, const BigInt& b) {
+    return make(multiplyMagnitudes(a.limbs, b.limbs),
+                a.negative != b.negative);
+  }
+
+  /// @brief Divides, truncating toward zero. The divisor must not be zero.
+  static void divide(const BigInt& a, const BigInt& b, BigInt& quotient,
+                     BigInt& remainder) {
+    Limbs q;
+    Limbs r;
+    divideMagnitudes(a.limbs, b.limbs, q, r);
+    quotient = make(std::move(q), a.negative != b.negative);
+    remainder = make(std::move(r), a.negative);
+  }
+
+  friend BigInt operator/(const BigInt& a, const BigInt& b) {
+    BigInt quotient;
+    BigInt remainder;
+    divide(a, b, quotient, remainder);
+    return quotient;
+  }
+
+  friend BigInt operator%(const BigInt& a, const BigInt& b) {
+    BigInt quotient;
+    BigInt remainder;
+    divide(a, b, quotient, remainder);
+    return remainder;
+  }
+
+  // The bitwise operators act on the infinite two's complement form, so
+  // negative values behave as though they had unlimited leading ones.
+
+  friend BigInt operator&(const BigInt& a, const BigInt& b) {
+    return combineBits(a, b, [](uint32_t x, uint32_t y) { return x & y; });
+  }
+
+  friend BigInt operator|(const BigInt& a, const BigInt& b) {
+    return combineBits(a, b, [](uint32_t x, uint32_t y) { return x | y; });
+  }
+
+  friend BigInt operator^(const BigInt& a, const BigInt& b) {
+    return combineBits(a, b, [](uint32_t x, uint32_t y) { return x ^ y; });
+  }
+
+  BigInt operator~() const { return -*this - BigInt(1); }
+
+  /// @brief Multiplies by 2^bits.
+  BigInt shiftLeft(uint64_t bits) const {
+    return make(shiftBitsUp(limbs, bits), negative);
+  }
+
+  /// @brief Divides by 2^bits, rounding toward negative infinity.
+  BigInt shiftRight(uint64_t bits) const {
+    if (!negative) {
+      return make(shiftBitsDown(limbs, bits), false);
+    }
+
+    // -((|a| - 1) >> bits) - 1 rounds down instead of toward zero.
+    auto below = subtractMagnitudes(limbs, Limbs{1});
+    return make(addMagnitudes(shiftBitsDown(below, bits), Limbs{1}), true);
+  }
+
+  static BigInt pow(BigInt base, uint64_t exponent) {
+    BigInt result(1);
+    while (exponent > 0) {
+      if (exponent & 1) {
+        result = result * base;
+      }
+      exponent >>= 1;
+      if (exponent > 0) {
+        base = base * base;
+      }
+    }
+    return result;
+  }
+
+  /// @brief Returns `base` raised to `exponent`, modulo `modulus`, in the
+  /// range [0, |modulus|). The exponent must not be negative and the
+  /// modulus must not be zero.
+  ///
+  /// Each step reduces the running product, so no intermediate value is
+  /// more than twice the size of the modulus.
+  static BigInt powMod(const BigInt& base, const BigInt& exponent,
+                       const BigInt& modulus) {
+    const auto& m = modulus.limbs;
+    auto reduce = [&m](const Limbs& value) {
+      Limbs quotient;
+      Limbs remainder;
+      divideMagnitudes(value, m, quotient, remainder);
+      return remainder;
+    };
+
+    auto b = reduce(base.limbs);
+    if (base.negative && !b.empty()) {
+      b = subtractMagnitudes(m, b);
+    }
+
+    Limbs result = reduce(Limbs{1});
+    for (auto i = exponent.limbs.size(); i-- > 0;) {
+      for (int bit = 31; bit >= 0; --bit) {
+        result = reduce(multiplyMagnitudes(result, result));
+        if ((exponent.limbs[i] >> bit) & 1) {
+          result = reduce(multiplyMagnitudes(result, b));
+        }
+      }
+    }
+
+    return make(std::move(result), false);
+  }
+
+ private:
+  // Below this many limbs in the smaller operand, schoolbook multiplication
+  // beats splitting.
+  static constexpr size_t KaratsubaThreshold = 48;
+  // From this many limbs in the divisor, division multiplies by a
+  // reciprocal instead of finding one quotient limb at a time.
+  static constexpr size_t NewtonThreshold = 64;
+  // Values with at most this many limbs are converted to and from decimal
+  // one digit group at a time.
+  static constexpr size_t DecimalThreshold = 32;
+  static constexpr uint32_t DigitGroupBase = 1000000000;
+  static constexpr size_t DigitGroupSize = 9;
+
+  /// @brief A power of ten used to split values for decimal conversion,
+  /// with its reciprocal once one is needed.
+  struct DecimalPower {
+    Limbs power;
+    Limbs inverse;
+  };
+
+  bool negative = false;
+  Limbs limbs;
+
+  static BigInt make(Limbs&& limbs, bool negative) {
+    BigInt result;
+    result.limbs = std::move(limbs);
+    result.negative = negative && !result.limbs.empty();
+    return result;
+  }
+
+  uint64_t getLow64() const {
+    uint64_t low = limbs.size() > 0 ? limbs[0] : 0;
+    uint64_t high = limbs.size() > 1 ? limbs[1] : 0;
+    return low | (high << 32);
+  }
+
+  static void trim(Limbs& value) {
+    while (!value.empty() && value.back() == 0) {
+      value.pop_back();
+    }
+  }
+
+  static int compareMagnitudes(const Limbs& a, const Limbs& b) {
+    if (a.size() != b.size()) {
+      return a.size() < b.size() ? -1 : 1;
+    }
+
+    for (auto i = a.size(); i-- > 0;) {
+      if (a[i] != b[i]) {
+        return a[i] < b[i] ? -1 : 1;
+      }
+    }
+    return 0;
+  }
+
+  static Limbs addMagnitudes(const Limbs& a, const Limbs& b) {
+    const auto& longer = a.size() >= b.size() ? a : b;
+    const auto& shorter = a.size() >= b.size() ? b : a;
+
+    Limbs sum(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); ++i) {
+      carry += static_cast<uint64_t>(longer[i]) +
+               (i < shorter.size() ? shorter[i] : 0);
+      sum[i] = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+    sum.back() = static_cast<uint32_t>(carry);
+    trim(sum);
+    return sum;
+  }
+
+  /// @brief Subtracts `b` from `a`, where `a` is at least `b`.
+  static Limbs subtractMagnitudes(const Limbs& a, const Limbs& b) {
+    Limbs difference(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+      auto value = static_cast<int64_t>(a[i]) - borrow -
+                   (i < b.size() ? static_cast<int64_t>(b[i]) : 0);
+      borrow = value < 0 ? 1 : 0;
+      difference[i] = static_cast<uint32_t>(value + (borrow << 32));
+    }
+    trim(difference);
+    return difference;
+  }
+
+  /// @brief Adds `b`, shifted up by `offset` limbs, into `a`, which must
+  /// have room for the result.
+  static void addShifted(Limbs& a, const Limbs& b, size_t offset) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < b.size(); ++i) {
+      carry += static_cast<uint64_t>(a[i + offset]) + b[i];
+      a[i + offset] = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+    for (; carry != 0; ++i) {
+      carry += a[i + offset];
+      a[i + offset] = static_cast<uint32_t>(carry);
+      carry >>= 32;
+    }
+  }
+
+  static Limbs multiplySchoolbook(const Limbs& a, const Limbs& b) {
+    Limbs product(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+      uint64_t carry = 0;
+      uint64_t digit = a[i];
+      for (size_t j = 0; j < b.size(); ++j) {
+        carry += digit * b[j] + product[i + j];
+        product[i + j] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+      }
+      product[i + b.size()] = static_cast<uint32_t>(carry);
+    }
+    trim(product);
+    return product;
+  }
+
+  /// @brief Multiplies with Karatsuba's method when both operands are
+  /// large, which takes three half-size products instead of four.
+  static Limbs multiplyMagnitudes(const Limbs& a, const Limbs& b) {
+    if (a.empty() || b.empty()) {
+      return {};
+    }
+
+    const auto& longer = a.size() >= b.size() ? a : b;
+    const auto& shorter = a.size() >= b.size() ? b : a;
+
+    if (shorter.size() < KaratsubaThreshold) {
+      return multiplySchoolbook(longer, shorter);
+    }
+
+    Limbs product(a.size() + b.size() + 1);
+
+    if (shorter.size() * 2 <= longer.size()) {
+      // Unbalanced: multiply the shorter operand by slices of the longer one
+      // of its own size, so each product is balanced.
+      for (size_t offset = 0; offset < longer.size();
+           offset += shorter.size()) {
+        auto end = std::min(offset + shorter.size(), longer.size());
+        Limbs slice(longer.begin() + offset, longer.begin() + end);
+        trim(slice);
+        addShifted(product, multiplyMagnitudes(slice, shorter), offset);
+      }
+      trim(product);
+      return product;
+    }
+
+    auto half = longer.size() / 2;
+    auto split = [half](const Limbs& value, Limbs& low, Limbs& high) {
+      auto middle = value.begin() + std::min(half, value.size());
+      low.assign(value.begin(), middle);
+      high.assign(middle, value.end());
+      trim(low);
+    };
+
+    Limbs aLow, aHigh, bLow, bHigh;
+    split(a, aLow, aHigh);
+    split(b, bLow, bHigh);
+
+    auto low = multiplyMagnitudes(aLow, bLow);
+    auto high = multiplyMagnitudes(aHigh, bHigh);
+    auto middle = multiplyMagnitudes(addMagnitudes(aLow, aHigh),
+                                     addMagnitudes(bLow, bHigh));
+    middle = subtractMagnitudes(subtractMagnitudes(middle, low), high);
+
+    addShifted(product, low, 0);
+    addShifted(product, middle, half);
+    addShifted(product, high, half * 2);
+    trim(product);
+    return product;
+  }
+
+  /// @brief Divides by a single limb, returning the remainder.
+  static uint32_t divideBySmall(const Limbs& a, uint32_t divisor,
+                                Limbs& quotient) {
+    quotient.assign(a.size(), 0);
+    uint64_t remainder = 0;
+    for (auto i = a.size(); i-- > 0;) {
+      auto current = (remainder << 32) | a[i];
+      quotient[i] = static_cast<uint32_t>(current / divisor);
+      remainder = current % divisor;
+    }
+    trim(quotient);
+    return static_cast<uint32_t>(remainder);
+  }
+
+  /// @brief Returns the low `size` limbs of the two's complement form.
+  static Limbs toTwosComplement(const BigInt& value, size_t size) {
+    Limbs bits(size, 0);
+    std::copy(value.limbs.begin(), value.limbs.end(), bits.begin());
+    if (value.negative) {
+      uint64_t carry = 1;
+      for (auto& limb : bits) {
+        carry += static_cast<uint32_t>(~limb);
+        limb = static_cast<uint32_t>(carry);
+        carry >>= 32;
+      }
+    }
+    return bits;
+  }
+
+  /// @brief Applies a bitwise operation limb by limb. One limb more than
+  /// either operand holds the sign.
+  template <typename Op>
+  static BigInt combineBits(const BigInt& a, const BigInt& b, Op op) {
+    auto size = std::max(a.limbs.size(), b.limbs.size()) + 1;
+    auto left = toTwosComplement(a, size);
+    auto right = toTwosComplement(b, size);
+    for (size_t i = 0; i < size; ++i) {
+      left[i] = op(left[i], right[i]);
+    }
+
+    if ((left.back() >> 31) == 0) {
+      trim(left);
+      return make(std::move(left), false);
+    }
+
+    // Negative: the magnitude is the two's complement of the result.
+    BigInt magnitude = make(Limbs(left), false);
+    auto result = toTwosComplement(-magnitude, size);
+    trim(result);
+    return make(std::move(result), true);
+  }
+
+  static Limbs shiftBitsUp(const Limbs& value, uint64_t bits) {
+    if (value.empty()) {
+      return {};
+    }
+
+    auto shifted = shiftUp(value, bits / 32);
+    auto offset = static_cast<unsigned>(bits % 32);
+    if (offset == 0) {
+      return shifted;
+    }
+
+    uint32_t carry = 0;
+    for (auto& limb : shifted) {
+      auto next = limb >> (32 - offset);
+      limb = (limb << offset) | carry;
+      carry = next;
+    }
+    if (carry != 0) {
+      shifted.push_back(carry);
+    }
+    return shifted;
+  }
+
+  static Limbs shiftBitsDown(const Limbs& value, uint64_t bits) {
+    auto shifted = shiftDown(value, bits / 32);
+    auto offset = static_cast<unsigned>(bits % 32);
+    if (offset == 0) {
+      return shifted;
+    }
+
+    for (size_t i = 0; i < shifted.size(); ++i) {
+      auto high = i + 1 < shifted.size() ? shifted[i + 1] : 0;
+      shifted[i] = (shifted[i] >> offset) | (high << (32 - offset));
+    }
+    trim(shifted);
+    return shifted;
+  }
+
+  /// @brief Multiplies by 2^(32 * count).
+  static Limbs shiftUp(const Limbs& value, size_t count) {
+    if (value.empty()) {
+      return {};
+    }
+
+    Limbs shifted(count, 0);
+    shifted.insert(shifted.end(), value.begin(), value.end());
+    return shifted;
+  }
+
+  /// @brief Divides by 2^(32 * count), truncating.
+  static Limbs shiftDown(const Limbs& value, size_t count) {
+    if (count >= value.size()) {
+      return {};
+    }
+    return Limbs(value.begin() + count, value.end());
+  }
+
+  /// @brief Divides magnitudes. The divisor must not be zero.
+  static void divideMagnitudes(const Limbs& u, const Limbs& v, Limbs& quotient,
+                               Limbs& remainder) {
+    if (compareMagnitudes(u, v) < 0) {
+      quotient.clear();
+      remainder = u;
+      return;
+    }
+
+    if (v.size() == 1) {
+      auto small = divideBySmall(u, v[0], quotient);
+      remainder.clear();
+      if (small != 0) {
+        remainder.push_back(small);
+      }
+      return;
+    }
+
+    // A reciprocal costs a few multiplications of the divisor's size, which
+    // only pays off when the quotient is not much shorter than the divisor.
+    if (v.size() >= NewtonThreshold && u.size() - v.size() >= v.size() / 2) {
+      divideByReciprocal(u, v, reciprocal(v), quotient, remainder);
+    } else {
+      divideSchoolbook(u, v, quotient, remainder);
+    }
+  }
+
+  /// @brief Returns floor(2^(64k) / v), where `v` has k limbs.
+  ///
+  /// The reciprocal of the top half of `v` is found first, recursively, and
+  /// one Newton step, x + x(2^(64k) - vx) / 2^(64k), doubles its precision.
+  /// The step only needs the top halves of its operands, and a final small
+  /// division corrects the last few units.
+  static Limbs reciprocal(const Limbs& v) {
+    auto k = v.size();
+    auto power = shiftUp(Limbs{1}, 2 * k);
+
+    if (k < NewtonThreshold) {
+      Limbs quotient;
+      Limbs remainder;
+      divideSchoolbook(power, v, quotient, remainder);
+      return quotient;
+    }
+
+    // x = top * 2^(32(k - half)) approximates the reciprocal.
+    auto half = (k + 1) / 2;
+    auto top = reciprocal(Limbs(v.end() - half, v.end()));
+    auto divisor = make(Limbs(v), false);
+    auto error = make(std::move(power), false) -
+                 make(shiftUp(multiplyMagnitudes(v, top), k - half), false);
+
+    // Dropping all but the top few limbs of the error changes the step by
+    // less than one.
+    auto dropped = k - 2;
+    auto product = multiplyMagnitudes(top, shiftDown(error.limbs, dropped));
+    auto step = make(shiftDown(product, k + half - dropped), error.negative);
+
+    auto x = make(shiftUp(top, k - half), false) + step;
+    error = error - divisor * step;
+
+    BigInt adjust;
+    BigInt rest;
+    divide(error, divisor, adjust, rest);
+    x = x + adjust;
+    if (rest.negative) {
+      x = x - BigInt(1);
+    }
+    return x.limbs;
+  }
+
+  /// @brief Divides by multiplying by the divisor's reciprocal.
+  ///
+  /// The dividend is taken k limbs at a time from the top, where k is the
+  /// divisor's size, so each step divides a value below 2^(64k). Only the
+  /// top half of that value goes into the product with the reciprocal,
+  /// which leaves the quotient at most a few units short.
+  static void divideByReciprocal(const Limbs& u, const Limbs& v,
+                                 const Limbs& inverse, Limbs& quotient,
+                                 Limbs& remainder) {
+    auto k = v.size();
+    auto chunks = (u.size() + k - 1) / k;
+
+    quotient.assign(chunks * k, 0);
+    remainder.clear();
+
+    for (auto chunk = chunks; chunk-- > 0;) {
+      auto first = u.begin() + chunk * k;
+      Limbs digits(first, first + std::min(k, u.size() - chunk * k));
+      trim(digits);
+
+      auto current = addMagnitudes(shiftUp(remainder, k), digits);
+      auto estimate = multiplyMagnitudes(shiftDown(current, k - 1), inverse);
+      auto part = shiftDown(estimate, k + 1);
+      remainder = subtractMagnitudes(current, multiplyMagnitudes(part, v));
+      while (compareMagnitudes(remainder, v) >= 0) {
+        remainder = subtractMagnitudes(remainder, v);
+        part = addMagnitudes(part, Limbs{1});
+      }
+
+      std::copy(part.begin(), part.end(), quotient.begin() + chunk * k);
+    }
+
+    trim(quotient);
+  }
+
+  /// @brief Divides with Knuth's algorithm D, one quotient limb at a time.
+  static void divideSchoolbook(const Limbs& u, const Limbs& v, Limbs& quotient,
+                               Limbs& remainder) {
+    if (v.size() == 1) {
+      auto small = divideBySmall(u, v[0], quotient);
+      remainder.clear();
+      if (small != 0) {
+        remainder.push_back(small);
+      }
+      return;
+    }
+
+    auto n = v.size();
+    auto m = u.size();
+
+    // Normalize so the divisor's top limb has its high bit set, which keeps
+    // each estimated quotient limb within two of the true one.
+    auto shift = static_cast<unsigned>(Bits::countLeadingZeros(v.back()));
+    auto shiftLeft = [shift](const Limbs& value, size_t size) {
+      Limbs shifted(size, 0);
+      for (size_t i = 0; i < value.size(); ++i) {
+        auto wide = static_cast<uint64_t>(value[i]) << shift;
+        shifted[i] |= static_cast<uint32_t>(wide);
+        if (i + 1 < size) {
+          shifted[i + 1] = static_cast<uint32_t>(wide >> 32);
+        }
+      }
+      return shifted;
+    };
+
+    auto vn = shiftLeft(v, n);
+    auto un = shiftLeft(u, m + 1);
+    quotient.assign(m - n + 1, 0);
+
+    for (auto j = m - n + 1; j-- > 0;) {
+      auto top = (static_cast<uint64_t>(un[j + n]) << 32) | un[j + n - 1];
+      auto qhat = top / vn[n - 1];
+      auto rhat = top % vn[n - 1];
+
+      while (qhat > 0xFFFFFFFFull ||
+             qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+        --qhat;
+        rhat += vn[n - 1];
+        if (rhat > 0xFFFFFFFFull) {
+          break;
+        }
+      }
+
+      // Subtract qhat times the divisor from the current window.
+      int64_t borrow = 0;
+      int64_t value = 0;
+      for (size_t i = 0; i < n; ++i) {
+        auto product = qhat * vn[i];
+        value = static_cast<int64_t>(un[i + j]) - borrow -
+                static_cast<int64_t>(product & 0xFFFFFFFFull);
+        un[i + j] = static_cast<uint32_t>(value);
+        borrow = static_cast<int64_t>(product >> 32) - (value >> 32);
+      }
+      value = static_cast<int64_t>(un[j + n]) - borrow;
+      un[j + n] = static_cast<uint32_t>(value);
+
+      // The estimate was one too large; add the divisor back.
+      if (value < 0) {
+        --qhat;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; ++i) {
+          carry += static_cast<uint64_t>(un[i + j]) + vn[i];
+          un[i + j] = static_cast<uint32_t>(carry);
+          carry >>= 32;
+        }
+        un[j + n] += static_cast<uint32_t>(carry);
+      }
+
+      quotient[j] = static_cast<uint32_t>(qhat);
+    }
+
+    trim(quotient);
+
+    remainder.assign(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+      remainder[i] = shift == 0 ? un[i]
+                                : (un[i] >> shift) |
+                                      static_cast<uint32_t>(
+                                          static_cast<uint64_t>(un[i + 1])
+                                          << (32 - shift));
+    }
+    trim(remainder);
+  }
+
+  /// @brief Returns 10^(9 * 2^level), computing and caching the powers up
+  /// to it.
+  static DecimalPower& getDecimalPower(std::vector<DecimalPower>& powers,
+                                       size_t level) {
+    if (powers.empty()) {
+      powers.push_back({Limbs{DigitGroupBase}, {}});
+    }
+    while (powers.size() <= level) {
+      auto next = multiplyMagnitudes(powers.back().power, powers.back().power);
+      powers.push_back({std::move(next), {}});
+    }
+    return powers[level];
+  }
+
+  /// @brief Appends the decimal digits of a magnitude, padded with leading
+  /// zeros to `width` digits.
+  static void appendDigits(const Limbs& value, size_t width,
+                           std::vector<DecimalPower>& powers,
+                           std::string& digits) {
+    if (value.size() <= DecimalThreshold) {
+      std::string chunk;
+      Limbs current = value;
+      Limbs quotient;
+      while (!current.empty()) {
+        auto group = divideBySmall(current, DigitGroupBase, quotient);
+        current.swap(quotient);
+        for (size_t i = 0; i < DigitGroupSize; ++i) {
+          chunk.push_back(static_cast<char>('0' + group % 10));
+          group /= 10;
+        }
+      }
+
+      while (chunk.size() > 1 && chunk.back() == '0') {
+        chunk.pop_back();
+      }
+      if (chunk.size() < width) {
+        chunk.append(width - chunk.size(), '0');
+      }
+      digits.append(chunk.rbegin(), chunk.rend());
+      return;
+    }
+
+    // Split by the largest cached power of ten at most half the value's size.
+    size_t level = 0;
+    while (getDecimalPower(powers, level + 1).power.size() * 2 <=
+           value.size()) {
+      ++level;
+    }
+
+    // Every split at one level divides by the same power, so its reciprocal
+    // is computed once.
+    auto& split = getDecimalPower(powers, level);
+    Limbs high;
+    Limbs low;
+    if (split.power.size() >= NewtonThreshold) {
+      if (split.inverse.empty()) {
+        split.inverse = reciprocal(split.power);
+      }
+      divideByReciprocal(value, split.power, split.inverse, high, low);
+    } else {
+      divideMagnitudes(value, split.power, high, low);
+    }
+
+    auto lowWidth = DigitGroupSize << level;
+    appendDigits(high, width > lowWidth ? width - lowWidth : 0, powers,
+                 digits);
+    appendDigits(low, lowWidth, powers, digits);
+  }
+
+  /// @brief Parses decimal digits by splitting them in two and combining
+  /// the parts with one multiplication, which Karatsuba makes fast.
+  static Limbs parseDigits(const char* digits, size_t count,
+                           std::vector<DecimalPower>& powers) {
+    if (count <= DecimalThreshold * DigitGroupSize) {
+      Limbs value;
+      for (size_t i = 0; i < count;) {
+        auto groupSize = std::min(DigitGroupSize, count - i);
+        uint32_t group = 0;
+        uint32_t scale = 1;
+        for (size_t end = i + groupSize; i < end; ++i) {
+          group = group * 10 + static_cast<uint32_t>(digits[i] - '0');
+          scale *= 10;
+        }
+
+        // value = value * scale + group
+        uint64_t carry = group;
+        for (auto& limb : value) {
+          carry += static_cast<uint64_t>(limb) * scale;
+          limb = static_cast<uint32_t>(carry);
+          carry >>= 32;
+        }
+        if (carry != 0) {
+          value.push_back(static_cast<uint32_t>(carry));
+        }
+      }
+      trim(value);
+      return value;
+    }
+
+    // The low part takes the most digits that a cached power of ten covers,
+    // which is at least half of them.
+    size_t level = 0;
+    while ((DigitGroupSize << (level + 1)) < count) {
+      ++level;
+    }
+
+    auto lowCount = DigitGroupSize << level;
+    auto highCount = count - lowCount;
+    auto high = parseDigits(digits, highCount, powers);
+    auto low = parseDigits(digits + highCount, lowCount, powers);
+
+    const auto& scale = getDecimalPower(powers, level).power;
+    return addMagnitudes(multiplyMagnitudes(high, scale), low);
+  }
+};
+
+#endif
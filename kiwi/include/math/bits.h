@@ -0,0 +1,116 @@
+#ifndef KIWI_MATH_BITS_H
+#define KIWI_MATH_BITS_H
+
+#include <cstdint>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// @brief Bit counting and overflow-checked arithmetic.
+///
+/// GCC and Clang have builtins for these, MSVC has intrinsics, and anything
+/// else gets plain C++ that computes the same results.
+struct Bits {
+  static int popcount(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<int>(__popcnt64(value));
+#else
+    value = value - ((value >> 1) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) +
+            ((value >> 2) & 0x3333333333333333ULL);
+    value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((value * 0x0101010101010101ULL) >> 56);
+#endif
+  }
+
+  /// @brief Counts the zero bits below the lowest set bit. The value must
+  /// not be zero.
+  static int countTrailingZeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    int count = 0;
+    while ((value & 1) == 0) {
+      value >>= 1;
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  /// @brief Counts the zero bits above the highest set bit. The value must
+  /// not be zero.
+  static int countLeadingZeros(uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clz(value);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return 31 - static_cast<int>(index);
+#else
+    int count = 0;
+    while ((value & 0x80000000u) == 0) {
+      value <<= 1;
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  /// @brief Adds, returning true if the sum overflowed. The result holds
+  /// the wrapped sum either way.
+  static bool addOverflow(long long left, long long right, long long& result) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_add_overflow(left, right, &result);
+#else
+    result = static_cast<long long>(static_cast<unsigned long long>(left) +
+                                    static_cast<unsigned long long>(right));
+    // Overflow flips the sign away from both operands.
+    return ((left ^ result) & (right ^ result)) < 0;
+#endif
+  }
+
+  /// @brief Subtracts, returning true if the difference overflowed.
+  static bool subOverflow(long long left, long long right, long long& result) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_sub_overflow(left, right, &result);
+#else
+    result = static_cast<long long>(static_cast<unsigned long long>(left) -
+                                    static_cast<unsigned long long>(right));
+    return ((left ^ right) & (left ^ result)) < 0;
+#endif
+  }
+
+  /// @brief Multiplies, returning true if the product overflowed.
+  static bool mulOverflow(long long left, long long right, long long& result) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_mul_overflow(left, right, &result);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    long long high;
+    result = _mul128(left, right, &high);
+    // The product fits when the high half only repeats the sign bit.
+    return high != (result >> 63);
+#else
+    result = static_cast<long long>(static_cast<unsigned long long>(left) *
+                                    static_cast<unsigned long long>(right));
+    if (left == 0 || right == 0) {
+      return false;
+    }
+    const auto min = std::numeric_limits<long long>::min();
+    if ((left == -1 && right == min) || (right == -1 && left == min)) {
+      return true;
+    }
+    return result / right != left;
+#endif
+  }
+};
+
+#endif
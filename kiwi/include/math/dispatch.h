@@ -0,0 +1,481 @@
+#ifndef KIWI_MATH_DISPATCH_H
+#define KIWI_MATH_DISPATCH_H
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+#include "math/bits.h"
+#include "parsing/tokens.h"
+#include "tracing/error.h"
+#include "typing/value.h"
+
+using BinaryHandler = k_value (*)(const Token& token, const k_value& left,
+                                  const k_value& right);
+
+/// @brief A specialized handler for one operator and one pair of operand
+/// types.
+struct BinaryEntry {
+  BinaryHandler handler = nullptr;
+  uint8_t left = 0;
+  uint8_t right = 0;
+};
+
+/// @brief Dispatches binary operations on numbers through a table indexed
+/// by operator, left operand type, and right operand type.
+///
+/// The table is built at compile time from one template per operator, so
+/// each entry is a handler for a single pair of types with no type checks
+/// left in it. Only numeric operands have entries; a missing entry means
+/// the caller falls back to the general implementation in `MathImpl`.
+class BinaryDispatch {
+ public:
+  /// @brief Returns the entry for an operation, or null when the operator
+  /// and operand types have no specialized handler.
+  static const BinaryEntry* find(KName op, size_t left, size_t right) {
+    auto row = getRow(op);
+    if (row == NoRow || left >= NumericTypes || right >= NumericTypes) {
+      return nullptr;
+    }
+
+    const auto& entry = table[row][left][right];
+    return entry.handler ? &entry : nullptr;
+  }
+
+  /// @brief Shifts an integer of any size left, which never overflows.
+  static k_value shiftLeft(const Token& token, const BigInt& value,
+                           k_int count) {
+    checkShift(token, count);
+    if (!value.isZero() && count > MaxShiftBits) {
+      throw InvalidOperationError(token, "Shift count is too large.");
+    }
+    return make_integer(value.shiftLeft(count));
+  }
+
+  /// @brief Shifts an integer of any size right, rounding down.
+  static k_value shiftRight(const Token& token, const BigInt& value,
+                            k_int count) {
+    checkShift(token, count);
+    return make_integer(value.shiftRight(count));
+  }
+
+ private:
+  static constexpr size_t IntType = 0;
+  static constexpr size_t DoubleType = 1;
+  static constexpr size_t NumericTypes = 2;
+  // Shifting further left would need gigabytes for the result.
+  static constexpr k_int MaxShiftBits = k_int(1) << 32;
+
+  static void checkShift(const Token& token, k_int count) {
+    if (count < 0) {
+      throw InvalidOperationError(token, "Negative shift count.");
+    }
+  }
+
+  static_assert(std::is_same_v<std::variant_alternative_t<IntType, k_value>,
+                               k_int>);
+  static_assert(std::is_same_v<
+                std::variant_alternative_t<DoubleType, k_value>, double>);
+
+  enum Row : uint8_t {
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulus,
+    Exponent,
+    BitwiseAnd,
+    BitwiseOr,
+    BitwiseXor,
+    LeftShift,
+    RightShift,
+    LessThan,
+    LessThanOrEqual,
+    GreaterThan,
+    GreaterThanOrEqual,
+    Equal,
+    NotEqual,
+    RowCount,
+    NoRow = 0xFF
+  };
+
+  using Cells = std::array<std::array<BinaryEntry, NumericTypes>, NumericTypes>;
+  using Table = std::array<Cells, RowCount>;
+
+  // Each operator works on the operand types as given. Operators marked
+  // `IntegerOnly` have entries for a pair of integers only, and those marked
+  // `SameType` for operands of the same type only, which is where the
+  // general implementation agrees with the arithmetic.
+  //
+  // Integer arithmetic that overflows a `k_int` produces a `k_bigint`
+  // instead; the check is a single flag test on the common path.
+  template <typename L, typename R>
+  static constexpr bool BothIntegers =
+      std::is_same_v<L, k_int> && std::is_same_v<R, k_int>;
+
+  struct AddOp {
+    template <typename L, typename R>
+    static k_value apply(const Token&, L left, R right) {
+      if constexpr (BothIntegers<L, R>) {
+        k_int result;
+        if (Bits::addOverflow(left, right, result)) {
+          return make_integer(BigInt(left) + BigInt(right));
+        }
+        return result;
+      } else {
+        return left + right;
+      }
+    }
+  };
+
+  struct SubtractOp {
+    template <typename L, typename R>
+    static k_value apply(const Token&, L left, R right) {
+      if constexpr (BothIntegers<L, R>) {
+        k_int result;
+        if (Bits::subOverflow(left, right, result)) {
+          return make_integer(BigInt(left) - BigInt(right));
+        }
+        return result;
+      } else {
+        return left - right;
+      }
+    }
+  };
+
+  struct MultiplyOp {
+    template <typename L, typename R>
+    static k_value apply(const Token&, L left, R right) {
+      if constexpr (BothIntegers<L, R>) {
+        k_int result;
+        if (Bits::mulOverflow(left, right, result)) {
+          return make_integer(BigInt(left) * BigInt(right));
+        }
+        return result;
+      } else {
+        return left * right;
+      }
+    }
+  };
+
+  struct DivideOp {
+    template <typename L, typename R>
+    static k_value apply(const Token& token, L left, R right) {
+      if (right == 0) {
+        throw DivideByZeroError(token);
+      }
+      if constexpr (BothIntegers<L, R>) {
+        if (right == -1) {
+          // Negating the smallest integer overflows.
+          return make_integer(-BigInt(left));
+        }
+        return left / right;
+      } else {
+        return static_cast<double>(left) / static_cast<double>(right);
+      }
+    }
+  };
+
+  struct ModulusOp {
+    template <typename L, typename R>
+    static k_value apply(const Token& token, L left, R right) {
+      if (right == 0) {
+        throw DivideByZeroError(token);
+      }
+      if constexpr (BothIntegers<L, R>) {
+        // The smallest integer modulo -1 traps on some hardware.
+        return right == -1 ? 0 : left % right;
+      } else {
+        return fmod(static_cast<double>(left), static_cast<double>(right));
+      }
+    }
+  };
+
+  struct ExponentOp {
+    template <typename L, typename R>
+    static k_value apply(const Token&, L left, R right) {
+      if constexpr (BothIntegers<L, R>) {
+        return right < 0 ? static_cast<k_int>(pow(left, right))
+                         : power(left, right);
+      } else {
+        return pow(static_cast<double>(left), static_cast<double>(right));
+      }
+    }
+  };
+
+  /// @brief Raises an integer to a non-negative power exactly, by repeated
+  /// squaring, moving to a `BigInt` if the result overflows.
+  static k_value power(k_int base, k_int exponent) {
+    k_int result = 1;
+    k_int square = base;
+    for (auto remaining = exponent; remaining > 0; remaining >>= 1) {
+      if ((remaining & 1) && Bits::mulOverflow(result, square, result)) {
+        return make_integer(BigInt::pow(BigInt(base), exponent));
+      }
+      if (remaining > 1 && Bits::mulOverflow(square, square, square)) {
+        return make_integer(BigInt::pow(BigInt(base), exponent));
+      }
+    }
+    return result;
+  }
+
+  struct BitwiseAndOp {
+    static constexpr bool IntegerOnly = true;
+    static k_value apply(const Token&, k_int left, k_int right) {
+      return left & right;
+    }
+  };
+
+  struct BitwiseOrOp {
+    static constexpr bool IntegerOnly = true;
+    static k_value apply(const Token&, k_int left, k_int right) {
+      return left | right;
+    }
+  };
+
+  struct BitwiseXorOp {
+    static constexpr bool IntegerOnly = true;
+    static k_value apply(const Token&, k_int left, k_int right) {
+      return left ^ right;
+    }
+  };
+
+  struct LeftShiftOp {
+    static constexpr bool IntegerOnly = true;
+    static k_value apply(const Token& token, k_int left, k_int right) {
+      checkShift(token, right);
+      if (right < 63) {
+        auto shifted =
+            static_cast<k_int>(static_cast<uint64_t>(left) << right);
+        // The shift is exact when shifting back recovers the value.
+        if ((shifted >> right) == left) {
+          return shifted;
+        }
+      }
+      return shiftLeft(token, BigInt(left), right);
+    }
+  };
+
+  struct RightShiftOp {
+    static constexpr bool IntegerOnly = true;
+    static k_value apply(const Token& token, k_int left, k_int right) {
+      checkShift(token, right);
+      if (right > 63) {
+        return left < 0 ? k_int(-1) : k_int(0);
+      }
+      return left >> right;
+    }
+  };
+
+  struct LessThanOp {
+    static constexpr bool SameType = true;
+    template <typename T>
+    static k_value apply(const Token&, T left, T right) {
+      return left < right;
+    }
+  };
+
+  struct LessThanOrEqualOp {
+    static constexpr bool SameType = true;
+    template <typename T>
+    static k_value apply(const Token&, T left, T right) {
+      return left <= right;
+    }
+  };
+
+  struct GreaterThanOp {
+    static constexpr bool SameType = true;
+    template <typename T>
+    static k_value apply(const Token&, T left, T right) {
+      return left > right;
+    }
+  };
+
+  struct GreaterThanOrEqualOp {
+    static constexpr bool SameType = true;
+    template <typename T>
+    static k_value apply(const Token&, T left, T right) {
+      return left >= right;
+    }
+  };
+
+  struct EqualOp {
+    static constexpr bool SameType = true;
+    template <typename T>
+    static k_value apply(const Token&, T left, T right) {
+      return left == right;
+    }
+  };
+
+  struct NotEqualOp {
+    static constexpr bool SameType = true;
+    template <typename T>
+    static k_value apply(const Token&, T left, T right) {
+      return left != right;
+    }
+  };
+
+  template <typename Op, typename = void>
+  struct IsIntegerOnly : std::false_type {};
+
+  template <typename Op>
+  struct IsIntegerOnly<Op, std::void_t<decltype(Op::IntegerOnly)>>
+      : std::true_type {};
+
+  template <typename Op, typename = void>
+  struct IsSameType : std::false_type {};
+
+  template <typename Op>
+  struct IsSameType<Op, std::void_t<decltype(Op::SameType)>>
+      : std::true_type {};
+
+  template <typename Op, size_t L, size_t R>
+  static k_value handle(const Token& token, const k_value& left,
+                        const k_value& right) {
+    return Op::apply(token, *std::get_if<L>(&left), *std::get_if<R>(&right));
+  }
+
+  template <typename Op, size_t L, size_t R>
+  static constexpr void fillCell(Cells& cells) {
+    constexpr bool skip =
+        (IsIntegerOnly<Op>::value && (L != IntType || R != IntType)) ||
+        (IsSameType<Op>::value && L != R);
+
+    if constexpr (!skip) {
+      cells[L][R] = {&handle<Op, L, R>, static_cast<uint8_t>(L),
+                     static_cast<uint8_t>(R)};
+    }
+  }
+
+  template <typename Op>
+  static constexpr Cells makeCells() {
+    Cells cells{};
+    fillCell<Op, IntType, IntType>(cells);
+    fillCell<Op, IntType, DoubleType>(cells);
+    fillCell<Op, DoubleType, IntType>(cells);
+    fillCell<Op, DoubleType, DoubleType>(cells);
+    return cells;
+  }
+
+  static constexpr Table makeTable() {
+    Table built{};
+    built[Add] = makeCells<AddOp>();
+    built[Subtract] = makeCells<SubtractOp>();
+    built[Multiply] = makeCells<MultiplyOp>();
+    built[Divide] = makeCells<DivideOp>();
+    built[Modulus] = makeCells<ModulusOp>();
+    built[Exponent] = makeCells<ExponentOp>();
+    built[BitwiseAnd] = makeCells<BitwiseAndOp>();
+    built[BitwiseOr] = makeCells<BitwiseOrOp>();
+    built[BitwiseXor] = makeCells<BitwiseXorOp>();
+    built[LeftShift] = makeCells<LeftShiftOp>();
+    built[RightShift] = makeCells<RightShiftOp>();
+    built[LessThan] = makeCells<LessThanOp>();
+    built[LessThanOrEqual] = makeCells<LessThanOrEqualOp>();
+    built[GreaterThan] = makeCells<GreaterThanOp>();
+    built[GreaterThanOrEqual] = makeCells<GreaterThanOrEqualOp>();
+    built[Equal] = makeCells<EqualOp>();
+    built[NotEqual] = makeCells<NotEqualOp>();
+    return built;
+  }
+
+  static const Table table;
+
+  static Row getRow(KName op) {
+    switch (op) {
+      case KName::Ops_Add:
+      case KName::Ops_AddAssign:
+        return Add;
+      case KName::Ops_Subtract:
+      case KName::Ops_SubtractAssign:
+        return Subtract;
+      case KName::Ops_Multiply:
+      case KName::Ops_MultiplyAssign:
+        return Multiply;
+      case KName::Ops_Divide:
+      case KName::Ops_DivideAssign:
+        return Divide;
+      case KName::Ops_Modulus:
+      case KName::Ops_ModuloAssign:
+        return Modulus;
+      case KName::Ops_Exponent:
+      case KName::Ops_ExponentAssign:
+        return Exponent;
+      case KName::Ops_BitwiseAnd:
+      case KName::Ops_BitwiseAndAssign:
+        return BitwiseAnd;
+      case KName::Ops_BitwiseOr:
+      case KName::Ops_BitwiseOrAssign:
+        return BitwiseOr;
+      case KName::Ops_BitwiseXor:
+      case KName::Ops_BitwiseXorAssign:
+        return BitwiseXor;
+      case KName::Ops_BitwiseLeftShift:
+      case KName::Ops_BitwiseLeftShiftAssign:
+        return LeftShift;
+      case KName::Ops_BitwiseRightShift:
+      case KName::Ops_BitwiseRightShiftAssign:
+        return RightShift;
+      case KName::Ops_LessThan:
+        return LessThan;
+      case KName::Ops_LessThanOrEqual:
+        return LessThanOrEqual;
+      case KName::Ops_GreaterThan:
+        return GreaterThan;
+      case KName::Ops_GreaterThanOrEqual:
+        return GreaterThanOrEqual;
+      case KName::Ops_Equal:
+        return Equal;
+      case KName::Ops_NotEqual:
+        return NotEqual;
+      default:
+        return NoRow;
+    }
+  }
+};
+
+constexpr BinaryDispatch::Table BinaryDispatch::table =
+    BinaryDispatch::makeTable();
+
+/// @brief Remembers the specialized handler a binary operation node first
+/// used, so later evaluations with the same operand types call it without
+/// looking up the operator.
+class BinaryOpCache {
+ public:
+  BinaryOpCache() {}
+  BinaryOpCache(const BinaryOpCache&) {}
+  BinaryOpCache& operator=(const BinaryOpCache&) { return *this; }
+
+  /// @brief Returns the cached handler when it matches the operand types.
+  BinaryHandler find(const k_value& left, const k_value& right) const {
+    auto entry = cached.load(std::memory_order_acquire);
+    if (entry && entry->left == left.index() &&
+        entry->right == right.index()) {
+      return entry->handler;
+    }
+    return nullptr;
+  }
+
+  /// @brief Caches the handler for the operand types, the first time the
+  /// node sees types that have one.
+  BinaryHandler quicken(KName op, const k_value& left,
+                        const k_value& right) const {
+    auto entry = BinaryDispatch::find(op, left.index(), right.index());
+    if (!entry) {
+      return nullptr;
+    }
+
+    if (!cached.load(std::memory_order_relaxed)) {
+      cached.store(entry, std::memory_order_release);
+    }
+    return entry->handler;
+  }
+
+ private:
+  mutable std::atomic<const BinaryEntry*> cached{nullptr};
+};
+
+#endif
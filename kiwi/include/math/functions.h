@@ -5,10 +5,12 @@
 #include <cmath>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include "parsing/tokens.h"
 #include "tracing/error.h"
 #include "typing/value.h"
+#include "dispatch.h"
 #include "rng.h"
 
 static k_string get_string(
@@ -39,6 +41,8 @@ static double get_double(
     return static_cast<double>(std::get<k_int>(arg));
   } else if (std::holds_alternative<double>(arg)) {
     return std::get<double>(arg);
+  } else if (std::holds_alternative<k_bigint>(arg)) {
+    return std::get<k_bigint>(arg)->toDouble();
   }
 
   throw ConversionError(term, message);
@@ -388,6 +392,12 @@ struct {
       case 8:  // k_null
         return false;
 
+      case 10:  // k_matrix
+        return !std::get<k_matrix>(value)->cells.empty();
+
+      case 11:  // k_bigint
+        return true;
+
       default:
         return false;
     }
@@ -471,6 +481,8 @@ struct {
   k_value do_bitwise_not(const Token& token, const k_value& left) {
     if (std::holds_alternative<k_int>(left)) {
       return ~std::get<k_int>(left);
+    } else if (std::holds_alternative<k_bigint>(left)) {
+      return make_integer(~*std::get<k_bigint>(left));
     } else if (std::holds_alternative<double>(left)) {
       return ~static_cast<k_int>(std::get<double>(left));
     } else if (std::holds_alternative<bool>(left)) {
@@ -502,9 +514,15 @@ struct {
 
   k_value do_negation(const Token& token, const k_value& right) {
     if (std::holds_alternative<k_int>(right)) {
-      return -std::get<k_int>(right);
+      auto value = std::get<k_int>(right);
+      if (value == std::numeric_limits<k_int>::min()) {
+        return make_integer(-BigInt(value));
+      }
+      return -value;
     } else if (std::holds_alternative<double>(right)) {
       return -std::get<double>(right);
+    } else if (std::holds_alternative<k_bigint>(right)) {
+      return make_integer(-*std::get<k_bigint>(right));
     } else {
       throw ConversionError(token,
                             "Unary minus applied to a non-numeric value.");
@@ -518,6 +536,8 @@ struct {
       return true;
     } else if (std::holds_alternative<k_int>(right)) {
       return static_cast<k_int>(std::get<k_int>(right) == 0 ? 1 : 0);
+    } else if (std::holds_alternative<k_bigint>(right)) {
+      return static_cast<k_int>(0);
     } else if (std::holds_alternative<double>(right)) {
       return std::get<double>(right) == 0;
     } else if (std::holds_alternative<k_string>(right)) {
@@ -536,6 +556,8 @@ struct {
       return static_cast<double>(std::get<k_int>(value));
     } else if (std::holds_alternative<double>(value)) {
       return std::get<double>(value);
+    } else if (std::holds_alternative<k_bigint>(value)) {
+      return std::get<k_bigint>(value)->toDouble();
     }
 
     throw ConversionError(token, "Cannot convert value to a double value.");
@@ -751,16 +773,43 @@ struct {
 
   k_value __abs__(const Token& token, const k_value& value) {
     if (std::holds_alternative<k_int>(value)) {
-      return static_cast<k_int>(
-          labs(static_cast<long>(std::get<k_int>(value))));
+      auto number = std::get<k_int>(value);
+      if (number == std::numeric_limits<k_int>::min()) {
+        return make_integer(-BigInt(number));
+      }
+      return static_cast<k_int>(labs(static_cast<long>(number)));
     } else if (std::holds_alternative<double>(value)) {
       return fabs(std::get<double>(value));
+    } else if (std::holds_alternative<k_bigint>(value)) {
+      const auto& number = *std::get<k_bigint>(value);
+      return make_integer(number.isNegative() ? -number : BigInt(number));
     }
 
     throw ConversionError(
         token, "Cannot take an absolute value of a non-numeric value.");
   }
 
+  /// @brief Returns `base` raised to `exponent`, modulo `modulus`, without
+  /// computing the full power.
+  k_value __powmod__(const Token& token, const k_value& base,
+                     const k_value& exponent, const k_value& modulus) {
+    if (!is_integer(base) || !is_integer(exponent) || !is_integer(modulus)) {
+      throw ConversionError(token, "Expected integer values in powmod.");
+    }
+
+    auto power = get_bigint(exponent);
+    auto divisor = get_bigint(modulus);
+    if (power.isNegative()) {
+      throw InvalidOperationError(
+          token, "Expected a non-negative exponent in powmod.");
+    }
+    if (divisor.isZero()) {
+      throw DivideByZeroError(token);
+    }
+
+    return make_integer(BigInt::powMod(get_bigint(base), power, divisor));
+  }
+
   std::vector<k_value> __divisors__(int number) {
     std::vector<k_value> divisors;
 
@@ -820,8 +869,118 @@ struct {
     }
   }
 
+  /// @brief Applies an arithmetic or bitwise operator when either operand
+  /// is a `k_bigint`. Returns nothing for anything else, which the general
+  /// implementation handles.
+  std::optional<k_value> do_bigint_op(const Token& token, const KName& op,
+                                      const k_value& left,
+                                      const k_value& right) {
+    // Mixed with a double, the arithmetic is done in floating point.
+    if (std::holds_alternative<double>(left) ||
+        std::holds_alternative<double>(right)) {
+      if (!is_integer(left) && !is_integer(right)) {
+        return std::nullopt;
+      }
+      return do_binary_op(token, op, get_double(token, left),
+                          get_double(token, right));
+    }
+
+    if ((op == KName::Ops_Add || op == KName::Ops_AddAssign) &&
+        (std::holds_alternative<k_string>(left) ||
+         std::holds_alternative<k_string>(right))) {
+      // One side is the string and the other the integer.
+      auto toString = [](const k_value& value) {
+        return std::holds_alternative<k_bigint>(value)
+                   ? std::get<k_bigint>(value)->toString()
+                   : std::get<k_string>(value);
+      };
+      return toString(left) + toString(right);
+    }
+
+    if (!is_integer(left) || !is_integer(right)) {
+      return std::nullopt;
+    }
+
+    auto lhs = get_bigint(left);
+    auto rhs = get_bigint(right);
+
+    switch (op) {
+      case KName::Ops_Add:
+      case KName::Ops_AddAssign:
+        return make_integer(lhs + rhs);
+      case KName::Ops_Subtract:
+      case KName::Ops_SubtractAssign:
+        return make_integer(lhs - rhs);
+      case KName::Ops_Multiply:
+      case KName::Ops_MultiplyAssign:
+        return make_integer(lhs * rhs);
+      case KName::Ops_Divide:
+      case KName::Ops_DivideAssign:
+      case KName::Ops_Modulus:
+      case KName::Ops_ModuloAssign: {
+        if (rhs.isZero()) {
+          throw DivideByZeroError(token);
+        }
+        BigInt quotient;
+        BigInt remainder;
+        BigInt::divide(lhs, rhs, quotient, remainder);
+        auto isDivide =
+            op == KName::Ops_Divide || op == KName::Ops_DivideAssign;
+        return make_integer(isDivide ? std::move(quotient)
+                                     : std::move(remainder));
+      }
+      case KName::Ops_Exponent:
+      case KName::Ops_ExponentAssign:
+        if (rhs.isNegative()) {
+          // As with smaller integers, the fraction is truncated away.
+          return static_cast<k_int>(0);
+        }
+        if (!rhs.fitsInt64()) {
+          throw InvalidOperationError(token, "Integer exponent is too large.");
+        }
+        return make_integer(BigInt::pow(lhs, rhs.toInt64()));
+      case KName::Ops_BitwiseAnd:
+      case KName::Ops_BitwiseAndAssign:
+        return make_integer(lhs & rhs);
+      case KName::Ops_BitwiseOr:
+      case KName::Ops_BitwiseOrAssign:
+        return make_integer(lhs | rhs);
+      case KName::Ops_BitwiseXor:
+      case KName::Ops_BitwiseXorAssign:
+        return make_integer(lhs ^ rhs);
+      case KName::Ops_BitwiseLeftShift:
+      case KName::Ops_BitwiseLeftShiftAssign:
+      case KName::Ops_BitwiseRightShift:
+      case KName::Ops_BitwiseRightShiftAssign: {
+        auto isLeft = op == KName::Ops_BitwiseLeftShift ||
+                      op == KName::Ops_BitwiseLeftShiftAssign;
+        // A count too large for a k_int shifts every bit out to the right,
+        // and is rejected to the left.
+        auto count = rhs.fitsInt64() ? static_cast<k_int>(rhs.toInt64())
+                     : rhs.isNegative()
+                         ? k_int(-1)
+                         : std::numeric_limits<k_int>::max();
+        return isLeft ? BinaryDispatch::shiftLeft(token, lhs, count)
+                      : BinaryDispatch::shiftRight(token, lhs, count);
+      }
+      default:
+        return std::nullopt;
+    }
+  }
+
   k_value do_binary_op(const Token& token, const KName& op, const k_value& left,
                        const k_value& right) {
+    if (auto entry = BinaryDispatch::find(op, left.index(), right.index())) {
+      return entry->handler(token, left, right);
+    }
+
+    if (std::holds_alternative<k_bigint>(left) ||
+        std::holds_alternative<k_bigint>(right)) {
+      if (auto result = do_bigint_op(token, op, left, right)) {
+        return *result;
+      }
+    }
+
     switch (op) {
       case KName::Ops_Add:
       case KName::Ops_AddAssign:
@@ -0,0 +1,275 @@
+#ifndef KIWI_MATH_MATRIX_H
+#define KIWI_MATH_MATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "typing/value.h"
+
+/// @brief Whole-matrix operations. Each runs in one native call, so scripts
+/// do not pay for interpreting every cell.
+///
+/// Work is split by rows. Operations that touch enough cells give each
+/// hardware thread a contiguous band of rows, so threads never write to the
+/// same cache lines.
+class MatrixKernels {
+ public:
+  enum class Reduction { Sum, Min, Max };
+
+  /// @brief Combines two matrices of the same shape cell by cell.
+  template <typename Op>
+  static k_matrix zip(const Matrix& left, const Matrix& right, Op op) {
+    auto result = std::make_shared<Matrix>(left.rows, left.cols);
+    const auto* a = left.cells.data();
+    const auto* b = right.cells.data();
+    auto* out = result->cells.data();
+
+    forEachRowBand(left.rows, left.cols, [&](size_t first, size_t last) {
+      for (auto i = first * left.cols; i < last * left.cols; ++i) {
+        out[i] = op(a[i], b[i]);
+      }
+    });
+
+    return result;
+  }
+
+  /// @brief Combines every cell of a matrix with a scalar.
+  template <typename Op>
+  static k_matrix zipScalar(const Matrix& left, double right, Op op) {
+    auto result = std::make_shared<Matrix>(left.rows, left.cols);
+    const auto* a = left.cells.data();
+    auto* out = result->cells.data();
+
+    forEachRowBand(left.rows, left.cols, [&](size_t first, size_t last) {
+      for (auto i = first * left.cols; i < last * left.cols; ++i) {
+        out[i] = op(a[i], right);
+      }
+    });
+
+    return result;
+  }
+
+  /// @brief Reduces every cell to one number.
+  static double reduce(const Matrix& matrix, Reduction reduction) {
+    auto total = getIdentity(reduction);
+    for (auto cell : matrix.cells) {
+      total = combine(reduction, total, cell);
+    }
+    return total;
+  }
+
+  /// @brief Reduces each column (axis 0) or each row (axis 1).
+  static std::vector<double> reduceAxis(const Matrix& matrix,
+                                        Reduction reduction, int axis) {
+    if (axis == 0) {
+      // Walk the rows in order, folding each into the column totals.
+      std::vector<double> totals(matrix.cols, getIdentity(reduction));
+      for (size_t row = 0; row < matrix.rows; ++row) {
+        const auto* cells = &matrix.cells[row * matrix.cols];
+        for (size_t col = 0; col < matrix.cols; ++col) {
+          totals[col] = combine(reduction, totals[col], cells[col]);
+        }
+      }
+      return totals;
+    }
+
+    std::vector<double> totals(matrix.rows, getIdentity(reduction));
+    for (size_t row = 0; row < matrix.rows; ++row) {
+      const auto* cells = &matrix.cells[row * matrix.cols];
+      for (size_t col = 0; col < matrix.cols; ++col) {
+        totals[row] = combine(reduction, totals[row], cells[col]);
+      }
+    }
+    return totals;
+  }
+
+  /// @brief Transposes in square tiles, so both the reads and the writes
+  /// stay within a few cache lines at a time.
+  static k_matrix transpose(const Matrix& matrix) {
+    auto result = std::make_shared<Matrix>(matrix.cols, matrix.rows);
+    auto& out = *result;
+
+    for (size_t rowTile = 0; rowTile < matrix.rows; rowTile += TransposeTile) {
+      auto rowEnd = std::min(rowTile + TransposeTile, matrix.rows);
+      for (size_t colTile = 0; colTile < matrix.cols;
+           colTile += TransposeTile) {
+        auto colEnd = std::min(colTile + TransposeTile, matrix.cols);
+        for (auto row = rowTile; row < rowEnd; ++row) {
+          for (auto col = colTile; col < colEnd; ++col) {
+            out.at(col, row) = matrix.at(row, col);
+          }
+        }
+      }
+    }
+
+    return result;
+  }
+
+  /// @brief Multiplies two matrices whose inner dimensions agree.
+  ///
+  /// The inner dimension is walked in blocks, and within a block each row of
+  /// the left matrix scales rows of the right one into a row of the result.
+  /// The innermost loop runs over contiguous cells of both, which the
+  /// compiler vectorizes, and a block of the right matrix stays in cache
+  /// while a band of result rows is built from it.
+  static k_matrix multiply(const Matrix& left, const Matrix& right) {
+    auto result = std::make_shared<Matrix>(left.rows, right.cols);
+    auto& out = *result;
+    auto inner = left.cols;
+    auto cols = right.cols;
+
+    forEachRowBand(left.rows, inner * cols, [&](size_t first, size_t last) {
+      for (size_t kTile = 0; kTile < inner; kTile += MultiplyTile) {
+        auto kEnd = std::min(kTile + MultiplyTile, inner);
+        for (auto row = first; row < last; ++row) {
+          auto* outRow = &out.cells[row * cols];
+          for (auto k = kTile; k < kEnd; ++k) {
+            auto scale = left.at(row, k);
+            const auto* rightRow = &right.cells[k * cols];
+            for (size_t col = 0; col < cols; ++col) {
+              outRow[col] += scale * rightRow[col];
+            }
+          }
+        }
+      }
+    });
+
+    return result;
+  }
+
+  /// @brief Applies a stencil to every cell: the result is the sum of the
+  /// neighborhood under the kernel, weighted by the kernel, with the kernel
+  /// centered on the cell. Neighbors past an edge count as zero, or wrap
+  /// around to the other side when `wrap` is set.
+  static k_matrix convolve(const Matrix& matrix, const Matrix& kernel,
+                           bool wrap) {
+    auto result = std::make_shared<Matrix>(matrix.rows, matrix.cols);
+    if (matrix.cells.empty()) {
+      return result;
+    }
+
+    auto& out = *result;
+    auto rows = static_cast<std::ptrdiff_t>(matrix.rows);
+    auto cols = static_cast<std::ptrdiff_t>(matrix.cols);
+    auto centerRow = static_cast<std::ptrdiff_t>(kernel.rows / 2);
+    auto centerCol = static_cast<std::ptrdiff_t>(kernel.cols / 2);
+
+    auto work = matrix.cols * kernel.rows * kernel.cols;
+    forEachRowBand(matrix.rows, work, [&](size_t first, size_t last) {
+      for (auto row = first; row < last; ++row) {
+        auto* outRow = &out.cells[row * matrix.cols];
+
+        // Each kernel cell adds a shifted row of the input, so the inner
+        // loop runs over contiguous cells.
+        for (size_t kRow = 0; kRow < kernel.rows; ++kRow) {
+          auto sourceRow = static_cast<std::ptrdiff_t>(row) +
+                           static_cast<std::ptrdiff_t>(kRow) - centerRow;
+          if (wrap) {
+            sourceRow = ((sourceRow % rows) + rows) % rows;
+          } else if (sourceRow < 0 || sourceRow >= rows) {
+            continue;
+          }
+
+          const auto* inRow = &matrix.cells[sourceRow * cols];
+          for (size_t kCol = 0; kCol < kernel.cols; ++kCol) {
+            auto weight = kernel.at(kRow, kCol);
+            if (weight == 0) {
+              continue;
+            }
+
+            auto shift = static_cast<std::ptrdiff_t>(kCol) - centerCol;
+            if (wrap) {
+              shift %= cols;
+            }
+            addShifted(outRow, inRow, cols, shift, weight, wrap);
+          }
+        }
+      }
+    });
+
+    return result;
+  }
+
+ private:
+  static constexpr size_t TransposeTile = 32;
+  static constexpr size_t MultiplyTile = 128;
+  // Below this many cells of work, a band of rows runs on the calling thread.
+  static constexpr size_t MinWorkPerThread = 1 << 16;
+
+  /// @brief Runs `work(first, last)` over bands of rows, in parallel when
+  /// there is enough work for more than one thread.
+  template <typename Work>
+  static void forEachRowBand(size_t rows, size_t workPerRow, Work&& work) {
+    auto totalWork = rows * std::max<size_t>(workPerRow, 1);
+    auto threadCount = std::min<size_t>(
+        std::max(1u, std::thread::hardware_concurrency()),
+        totalWork / MinWorkPerThread);
+    threadCount = std::max<size_t>(std::min(threadCount, rows), 1);
+
+    if (threadCount == 1) {
+      work(0, rows);
+      return;
+    }
+
+    auto perThread = (rows + threadCount - 1) / threadCount;
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount);
+    for (size_t first = 0; first < rows; first += perThread) {
+      workers.emplace_back(work, first, std::min(first + perThread, rows));
+    }
+
+    for (auto& thread : workers) {
+      thread.join();
+    }
+  }
+
+  /// @brief Adds a row shifted by `shift` columns and scaled by `weight`.
+  static void addShifted(double* out, const double* in, std::ptrdiff_t cols,
+                         std::ptrdiff_t shift, double weight, bool wrap) {
+    // The columns whose source is inside the row.
+    auto begin = std::max<std::ptrdiff_t>(0, -shift);
+    auto end = std::min<std::ptrdiff_t>(cols, cols - shift);
+
+    for (auto col = begin; col < end; ++col) {
+      out[col] += weight * in[col + shift];
+    }
+
+    if (!wrap) {
+      return;
+    }
+
+    // The shift is less than a row here, so only one side wraps.
+    for (std::ptrdiff_t col = 0; col < begin; ++col) {
+      out[col] += weight * in[col + shift + cols];
+    }
+    for (auto col = end; col < cols; ++col) {
+      out[col] += weight * in[col + shift - cols];
+    }
+  }
+
+  static double getIdentity(Reduction reduction) {
+    switch (reduction) {
+      case Reduction::Min:
+        return std::numeric_limits<double>::infinity();
+      case Reduction::Max:
+        return -std::numeric_limits<double>::infinity();
+      default:
+        return 0.0;
+    }
+  }
+
+  static double combine(Reduction reduction, double total, double cell) {
+    switch (reduction) {
+      case Reduction::Min:
+        return std::min(total, cell);
+      case Reduction::Max:
+        return std::max(total, cell);
+      default:
+        return total + cell;
+    }
+  }
+};
+
+#endif
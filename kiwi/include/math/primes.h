@@ -1,104 +1,472 @@
 #ifndef KIWI_MATH_PRIMES_H
 #define KIWI_MATH_PRIMES_H
 
-#include <iostream>
-#include <vector>
-#include <cmath>
 #include <algorithm>
-#include <iterator>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bits.h"
 
-class PrimeGenerator {
- public:
-  static int nthPrime(int n);
-  static std::vector<int> listPrimes(int limit);
+/// @brief The small primes whose multiples are laid into a sieve segment a
+/// word at a time, instead of being crossed off one by one.
+///
+/// Bit k of a segment stands for the odd number 2k + 1, so the multiples of
+/// a prime p are the bits with k mod p == (p - 1) / 2. For each prime and
+/// each phase r, the mask holds the bits of a word starting at a bit k with
+/// k mod p == r that stand for multiples of p.
+struct PrimeWheel {
+  static constexpr std::array<uint64_t, 5> Primes = {3, 5, 7, 11, 13};
 
- private:
-  static void simpleSieve(int limit, std::vector<int>& primes);
+  std::array<std::array<uint64_t, 13>, 5> masks{};
+
+  constexpr PrimeWheel() {
+    for (size_t i = 0; i < Primes.size(); ++i) {
+      auto p = Primes[i];
+      for (uint64_t r = 0; r < p; ++r) {
+        uint64_t mask = 0;
+        for (uint64_t j = 0; j < 64; ++j) {
+          if ((r + j) % p == (p - 1) / 2) {
+            mask |= 1ULL << j;
+          }
+        }
+        masks[i][r] = mask;
+      }
+    }
+  }
 };
 
-void PrimeGenerator::simpleSieve(int limit, std::vector<int>& primes) {
-  std::vector<bool> mark(limit + 1, true);
+inline constexpr PrimeWheel primeWheel{};
+
+/// @brief A segmented sieve of Eratosthenes over odd numbers.
+///
+/// Each bit of a segment stands for one odd number, so a 32 KB segment,
+/// which fits in the L1 cache, covers half a million numbers. Bits are set
+/// for composites. A segment starts from a precomputed wheel of the
+/// multiples of 3, 5, 7, 11, and 13, laid down a word at a time, and only
+/// larger primes are crossed off one multiple at a time. Segments do not
+/// depend on each other, so they can be sieved in parallel.
+class PrimeSieve {
+ public:
+  static constexpr uint64_t SegmentWords = 4096;
+  static constexpr uint64_t SegmentBits = SegmentWords * 64;
+
+  explicit PrimeSieve(uint64_t limit) : limit(limit) {
+    lastBit = limit < 3 ? 0 : (limit - 1) / 2;
+    segments = limit < 3 ? 0 : lastBit / SegmentBits + 1;
+    findBasePrimes(isqrt(limit));
+  }
+
+  uint64_t getLimit() const { return limit; }
+
+  size_t getSegmentCount() const { return static_cast<size_t>(segments); }
 
-  for (int p = 2; p * p < limit; p++) {
-    if (mark[p]) {
-      for (int i = p * p; i < limit; i += p) {
-        mark[i] = false;
+  /// @brief The next multiple of a base prime to cross off: its bit, and
+  /// where its cofactor is on the wheel of numbers coprime to 30.
+  struct Multiple {
+    uint64_t bit;
+    uint32_t spoke;
+  };
+
+  /// @brief Sets `multiples` to the first multiple in or after a segment
+  /// that each base prime crosses off.
+  void findMultiples(size_t segment, std::vector<Multiple>& multiples) const {
+    auto firstNumber = 2 * (segment * SegmentBits) + 1;
+    multiples.resize(basePrimes.size());
+
+    for (size_t i = 0; i < basePrimes.size(); ++i) {
+      // Multiples of p with a cofactor divisible by 2, 3, or 5 are left to
+      // the wheel, so the cofactor steps through the numbers coprime to 30,
+      // starting from p itself.
+      auto p = basePrimes[i];
+      auto cofactor = std::max(p, (firstNumber + p - 1) / p);
+      while (Spokes[cofactor % 30] < 0) {
+        ++cofactor;
       }
+
+      // Bit k stands for the odd number 2k + 1.
+      multiples[i] = {(p * cofactor - 1) / 2,
+                      static_cast<uint32_t>(Spokes[cofactor % 30])};
     }
   }
 
-  for (int p = 2; p < limit; p++) {
-    if (mark[p]) {
-      primes.emplace_back(p);
+  /// @brief Sieves a segment into `words`. `multiples` must come from
+  /// `findMultiples` for this segment, or from sieving the one before it,
+  /// and is left ready for the next segment.
+  void sieve(size_t segment, std::vector<uint64_t>& words,
+             std::vector<Multiple>& multiples) const {
+    auto firstBit = segment * SegmentBits;
+    auto wordCount = std::min(SegmentWords, (lastBit - firstBit) / 64 + 1);
+    words.assign(wordCount, 0);
+
+    for (size_t i = 0; i < PrimeWheel::Primes.size(); ++i) {
+      auto p = PrimeWheel::Primes[i];
+      auto phase = static_cast<size_t>(firstBit % p);
+      auto step = static_cast<size_t>(64 % p);
+      for (auto& word : words) {
+        word |= primeWheel.masks[i][phase];
+        phase += step;
+        if (phase >= p) {
+          phase -= p;
+        }
+      }
+    }
+
+    auto endBit = firstBit + wordCount * 64;
+    for (size_t i = 0; i < basePrimes.size(); ++i) {
+      auto p = basePrimes[i];
+      auto [bit, spoke] = multiples[i];
+      while (bit < endBit) {
+        auto index = bit - firstBit;
+        words[index / 64] |= 1ULL << (index % 64);
+        bit += p * SpokeGaps[spoke];
+        spoke = (spoke + 1) % SpokeGaps.size();
+      }
+      multiples[i] = {bit, spoke};
     }
-  }
-}
 
-int PrimeGenerator::nthPrime(int n) {
-  if (n == 0) {
-    return 2;
+    if (segment == 0) {
+      // 1 is not prime, and the wheel primes are not their own multiples.
+      words[0] |= 1;
+      for (auto p : PrimeWheel::Primes) {
+        auto index = (p - 1) / 2;
+        if (index <= lastBit) {
+          words[0] &= ~(1ULL << index);
+        }
+      }
+    }
+
+    // Mark the bits past the limit in the last word.
+    auto tail = (lastBit - firstBit) + 1;
+    if (tail < wordCount * 64) {
+      words.back() |= ~0ULL << (tail % 64);
+    }
   }
-  int limit = std::floor(sqrt(n) * log(n)) + 1;
-  std::vector<int> primes;
-  simpleSieve(limit, primes);
 
-  int count = primes.size();
-  int low = limit;
-  int high = 2 * limit;
+  /// @brief Counts the odd primes in a sieved segment.
+  static uint64_t count(const std::vector<uint64_t>& words) {
+    uint64_t total = 0;
+    for (auto word : words) {
+      total += static_cast<uint64_t>(Bits::popcount(~word));
+    }
+    return total;
+  }
 
-  while (count < n + 1) {
-    std::vector<bool> mark(limit + 1, true);
+  /// @brief Calls `visit` with each odd prime in a sieved segment, in order,
+  /// until it returns false. Returns false if it was stopped.
+  template <typename Visitor>
+  static bool forEach(size_t segment, const std::vector<uint64_t>& words,
+                      Visitor&& visit) {
+    auto firstBit = segment * SegmentBits;
+    for (size_t i = 0; i < words.size(); ++i) {
+      auto primes = ~words[i];
+      while (primes != 0) {
+        auto bit = firstBit + i * 64 +
+                   static_cast<uint64_t>(Bits::countTrailingZeros(primes));
+        if (!visit(2 * bit + 1)) {
+          return false;
+        }
+        primes &= primes - 1;
+      }
+    }
+    return true;
+  }
 
-    for (int i = 0; i < static_cast<int>(primes.size()); i++) {
-      int loLim = std::floor(low / primes[i]) * primes[i];
+  /// @brief Runs `work(segment, words)` for every segment. When there are
+  /// enough segments, each hardware thread sieves a contiguous run of them,
+  /// and the first exception a thread throws is rethrown after all finish.
+  template <typename Work>
+  void forEachSegment(Work&& work) const {
+    auto segmentCount = getSegmentCount();
+    auto threadCount = std::min<size_t>(
+        std::max(1u, std::thread::hardware_concurrency()),
+        segmentCount / MinSegmentsPerThread);
+    threadCount = std::max<size_t>(threadCount, 1);
 
-      if (loLim < low) {
-        loLim += primes[i];
+    auto run = [&](size_t first, size_t last) {
+      std::vector<uint64_t> words;
+      std::vector<Multiple> multiples;
+      findMultiples(first, multiples);
+      for (auto segment = first; segment < last; ++segment) {
+        sieve(segment, words, multiples);
+        work(segment, words);
       }
+    };
+
+    if (threadCount == 1) {
+      run(0, segmentCount);
+      return;
+    }
 
-      for (int j = loLim; j < high; j += primes[i]) {
-        mark[j - low] = false;
+    std::exception_ptr failure;
+    std::mutex failureMutex;
+    auto guarded = [&](size_t first, size_t last) {
+      try {
+        run(first, last);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(failureMutex);
+        if (!failure) {
+          failure = std::current_exception();
+        }
       }
+    };
+
+    auto perThread = (segmentCount + threadCount - 1) / threadCount;
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount);
+    for (size_t first = 0; first < segmentCount; first += perThread) {
+      workers.emplace_back(guarded, first,
+                           std::min(first + perThread, segmentCount));
+    }
+
+    for (auto& thread : workers) {
+      thread.join();
+    }
+
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+  }
+
+  static uint64_t isqrt(uint64_t n) {
+    auto root = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+    while (root > 0 && root > n / root) {
+      --root;
     }
+    while ((root + 1) <= n / (root + 1)) {
+      ++root;
+    }
+    return root;
+  }
+
+ private:
+  static constexpr size_t MinSegmentsPerThread = 4;
+
+  // The position of each residue modulo 30 on the wheel of residues coprime
+  // to 30, or -1, and the gap in bits from each spoke to the next, which is
+  // half the gap between the residues.
+  static constexpr std::array<int8_t, 30> Spokes = {
+      -1, 0,  -1, -1, -1, -1, -1, 1,  -1, -1, -1, 2,  -1, 3,  -1,
+      -1, -1, 4,  -1, 5,  -1, -1, -1, 6,  -1, -1, -1, -1, -1, 7};
+  static constexpr std::array<uint64_t, 8> SpokeGaps = {3, 2, 1, 2,
+                                                        1, 2, 3, 1};
 
-    for (int i = low; i < high && count < n + 1; i++) {
-      if (mark[i - low]) {
-        if (count == n) {
-          return i;
+  uint64_t limit;
+  uint64_t lastBit = 0;
+  uint64_t segments = 0;
+  std::vector<uint64_t> basePrimes;
+
+  /// @brief Finds the primes above the wheel up to `bound`, which cross off
+  /// the composites in each segment.
+  void findBasePrimes(uint64_t bound) {
+    std::vector<bool> composite(bound + 1, false);
+
+    for (uint64_t p = 3; p * p <= bound; p += 2) {
+      if (!composite[p]) {
+        for (auto multiple = p * p; multiple <= bound; multiple += 2 * p) {
+          composite[multiple] = true;
         }
+      }
+    }
+
+    for (uint64_t p = PrimeWheel::Primes.back() + 2; p <= bound; p += 2) {
+      if (!composite[p]) {
+        basePrimes.push_back(p);
+      }
+    }
+  }
+};
+
+/// @brief Streams the primes up to a limit in order, sieving one segment
+/// at a time.
+class PrimeIterator {
+ public:
+  explicit PrimeIterator(uint64_t limit) : sieve(limit) {}
+
+  /// @brief Stores the next prime in `prime`, or returns false when there
+  /// are no more primes up to the limit.
+  bool next(uint64_t& prime) {
+    if (!yieldedTwo) {
+      yieldedTwo = true;
+      if (sieve.getLimit() >= 2) {
+        prime = 2;
+        return true;
+      }
+    }
 
-        count++;
+    while (pending == 0) {
+      if (nextSegment >= sieve.getSegmentCount()) {
+        return false;
       }
+
+      segment = nextSegment++;
+      if (segment == 0) {
+        sieve.findMultiples(segment, multiples);
+      }
+      sieve.sieve(segment, words, multiples);
+      wordIndex = 0;
+      pending = words.empty() ? 0 : ~words[0];
+
+      while (pending == 0 && ++wordIndex < words.size()) {
+        pending = ~words[wordIndex];
+      }
+    }
+
+    auto bit = segment * PrimeSieve::SegmentBits + wordIndex * 64 +
+               static_cast<uint64_t>(Bits::countTrailingZeros(pending));
+    prime = 2 * bit + 1;
+    pending &= pending - 1;
+
+    while (pending == 0 && ++wordIndex < words.size()) {
+      pending = ~words[wordIndex];
     }
 
-    low += limit;
-    high += limit;
+    return true;
+  }
+
+ private:
+  PrimeSieve sieve;
+  std::vector<uint64_t> words;
+  std::vector<PrimeSieve::Multiple> multiples;
+  size_t nextSegment = 0;
+  size_t segment = 0;
+  size_t wordIndex = 0;
+  uint64_t pending = 0;
+  bool yieldedTwo = false;
+};
+
+class PrimeGenerator {
+ public:
+  static int64_t nthPrime(int64_t n);
+  static std::vector<int64_t> listPrimes(int64_t limit);
+  static int64_t countPrimes(int64_t limit);
+
+ private:
+  // Below this many segments, sieving runs on the calling thread.
+  static constexpr size_t ParallelSegments = 8;
+
+  static uint64_t upperBound(int64_t n);
+};
+
+/// @brief Returns a bound on the n-th prime (Rosser's theorem), n >= 1.
+inline uint64_t PrimeGenerator::upperBound(int64_t n) {
+  if (n < 6) {
+    return 13;
   }
 
-  return -1;
+  auto x = static_cast<double>(n);
+  return static_cast<uint64_t>(x * (std::log(x) + std::log(std::log(x)))) + 1;
 }
 
-std::vector<int> PrimeGenerator::listPrimes(int limit) {
-  std::vector<bool> is_prime(limit + 1, true);
-  std::vector<int> primes;
+/// @brief Returns the n-th prime, counting 2 as the first, or -1 when n is
+/// less than one.
+inline int64_t PrimeGenerator::nthPrime(int64_t n) {
+  if (n < 1) {
+    return -1;
+  }
 
-  is_prime[0] = is_prime[1] = false;  // 0 and 1 are not prime numbers
+  PrimeSieve sieve(upperBound(n));
 
-  for (int num = 2; num <= sqrt(limit); ++num) {
-    if (is_prime[num]) {
-      for (int multiple = num * num; multiple <= limit; multiple += num) {
-        is_prime[multiple] = false;
-      }
+  if (sieve.getSegmentCount() < ParallelSegments) {
+    PrimeIterator primes(sieve.getLimit());
+    uint64_t prime = 0;
+    for (int64_t i = 0; i < n; ++i) {
+      primes.next(prime);
     }
+    return static_cast<int64_t>(prime);
+  }
+
+  std::vector<uint64_t> counts(sieve.getSegmentCount());
+  sieve.forEachSegment([&counts](size_t segment, const auto& words) {
+    counts[segment] = PrimeSieve::count(words);
+  });
+
+  // Find the segment holding the n-th prime, then walk its bits.
+  auto remaining = static_cast<uint64_t>(n - 1);
+  size_t segment = 0;
+  while (counts[segment] < remaining) {
+    remaining -= counts[segment++];
+  }
+
+  std::vector<uint64_t> words;
+  std::vector<PrimeSieve::Multiple> multiples;
+  sieve.findMultiples(segment, multiples);
+  sieve.sieve(segment, words, multiples);
+
+  uint64_t result = 0;
+  PrimeSieve::forEach(segment, words, [&](uint64_t prime) {
+    result = prime;
+    return --remaining > 0;
+  });
+
+  return static_cast<int64_t>(result);
+}
+
+/// @brief Returns the primes up to and including `limit`.
+inline std::vector<int64_t> PrimeGenerator::listPrimes(int64_t limit) {
+  std::vector<int64_t> primes;
+  if (limit < 2) {
+    return primes;
   }
 
-  for (int num = 2; num <= limit; ++num) {
-    if (is_prime[num]) {
-      primes.emplace_back(num);
+  PrimeSieve sieve(static_cast<uint64_t>(limit));
+  auto segmentCount = sieve.getSegmentCount();
+
+  if (segmentCount < ParallelSegments) {
+    PrimeIterator iterator(sieve.getLimit());
+    uint64_t prime = 0;
+    while (iterator.next(prime)) {
+      primes.push_back(static_cast<int64_t>(prime));
     }
+    return primes;
+  }
+
+  std::vector<std::vector<int64_t>> found(segmentCount);
+  sieve.forEachSegment([&found](size_t segment, const auto& words) {
+    auto& out = found[segment];
+    out.reserve(PrimeSieve::count(words));
+    PrimeSieve::forEach(segment, words, [&out](uint64_t prime) {
+      out.push_back(static_cast<int64_t>(prime));
+      return true;
+    });
+  });
+
+  size_t total = 1;
+  for (const auto& segment : found) {
+    total += segment.size();
+  }
+
+  primes.reserve(total);
+  primes.push_back(2);
+  for (const auto& segment : found) {
+    primes.insert(primes.end(), segment.begin(), segment.end());
   }
 
   return primes;
 }
 
-#endif
\ No newline at end of file
+/// @brief Returns how many primes are at most `limit`, without storing
+/// them, so limits far past what a list could hold are fine.
+inline int64_t PrimeGenerator::countPrimes(int64_t limit) {
+  if (limit < 2) {
+    return 0;
+  }
+
+  PrimeSieve sieve(static_cast<uint64_t>(limit));
+  std::vector<uint64_t> counts(sieve.getSegmentCount());
+  sieve.forEachSegment([&counts](size_t segment, const auto& words) {
+    counts[segment] = PrimeSieve::count(words);
+  });
+
+  // The sieve holds odd numbers only, so 2 is counted here.
+  int64_t total = 1;
+  for (auto count : counts) {
+    total += static_cast<int64_t>(count);
+  }
+  return total;
+}
+
+#endif
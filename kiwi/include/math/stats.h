@@ -0,0 +1,156 @@
+#ifndef KIWI_MATH_STATS_H
+#define KIWI_MATH_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/// @brief Summary statistics over a buffer of numbers.
+class Stats {
+ public:
+  struct Moments {
+    double count = 0;
+    double mean = 0;
+    // The sum of squared differences from the mean.
+    double m2 = 0;
+  };
+
+  /// @brief Computes the mean and the sum of squared deviations in one pass.
+  ///
+  /// Each of several lanes runs Welford's update over every few elements,
+  /// which keeps the lanes independent of each other, and the lanes are
+  /// merged at the end with Chan's formula. Both steps stay accurate when
+  /// the values are large relative to their spread.
+  static Moments moments(const std::vector<double>& values) {
+    Moments lanes[Lanes];
+    size_t i = 0;
+
+    for (; i + Lanes <= values.size(); i += Lanes) {
+      for (size_t lane = 0; lane < Lanes; ++lane) {
+        update(lanes[lane], values[i + lane]);
+      }
+    }
+
+    for (; i < values.size(); ++i) {
+      update(lanes[0], values[i]);
+    }
+
+    Moments total;
+    for (const auto& lane : lanes) {
+      total = merge(total, lane);
+    }
+    return total;
+  }
+
+  static double mean(const std::vector<double>& values) {
+    return moments(values).mean;
+  }
+
+  /// @brief Returns the population variance.
+  static double variance(const std::vector<double>& values) {
+    auto total = moments(values);
+    return total.count > 0 ? total.m2 / total.count : 0.0;
+  }
+
+  /// @brief Returns the q-quantile, interpolating linearly between the two
+  /// nearest values. Reorders `values`, which must not hold NaN.
+  ///
+  /// The values on each side of the quantile are found by selection, which
+  /// takes linear time instead of sorting the whole buffer.
+  static double quantile(std::vector<double>& values, double q) {
+    auto position = q * static_cast<double>(values.size() - 1);
+    auto lower = static_cast<size_t>(std::floor(position));
+    auto fraction = position - static_cast<double>(lower);
+
+    auto nth = values.begin() + static_cast<std::ptrdiff_t>(lower);
+    std::nth_element(values.begin(), nth, values.end());
+    auto low = *nth;
+
+    if (fraction == 0 || lower + 1 >= values.size()) {
+      return low;
+    }
+
+    // Everything after the lower value is at least as large, so the next
+    // value is the smallest of them.
+    auto high = *std::min_element(nth + 1, values.end());
+    return low + fraction * (high - low);
+  }
+
+  /// @brief Counts the values in `bins` equal-width bins between the
+  /// smallest and largest value. The last bin includes the largest value.
+  /// Values outside the range fall in the first or last bin.
+  static std::vector<size_t> histogram(const std::vector<double>& values,
+                                       size_t bins, double low, double high) {
+    std::vector<size_t> counts(bins, 0);
+    auto width = binWidth(bins, low, high);
+    auto last = static_cast<double>(bins - 1);
+
+    for (auto value : values) {
+      // Clamp before converting, since converting a double that does not
+      // fit in size_t is undefined.
+      size_t bin = 0;
+      if (width > 0 && value > low) {
+        bin = static_cast<size_t>(
+            std::min(value / width - low / width, last));
+      }
+      counts[bin]++;
+    }
+
+    return counts;
+  }
+
+  /// @brief Returns the `bins + 1` edges of the bins `histogram` uses.
+  static std::vector<double> binEdges(size_t bins, double low, double high) {
+    std::vector<double> edges(bins + 1);
+    auto width = binWidth(bins, low, high);
+    for (size_t i = 0; i < bins; ++i) {
+      edges[i] = low + width * static_cast<double>(i);
+    }
+    edges[bins] = high;
+    return edges;
+  }
+
+  /// @brief Returns the index of the first smallest value, or of the first
+  /// largest one when `largest` is set.
+  static size_t argExtreme(const std::vector<double>& values, bool largest) {
+    auto it = largest ? std::max_element(values.begin(), values.end())
+                      : std::min_element(values.begin(), values.end());
+    return static_cast<size_t>(it - values.begin());
+  }
+
+ private:
+  static constexpr size_t Lanes = 4;
+
+  /// @brief Divides before subtracting, so the width of a range wider than
+  /// the largest double stays finite.
+  static double binWidth(size_t bins, double low, double high) {
+    auto count = static_cast<double>(bins);
+    return high / count - low / count;
+  }
+
+  static void update(Moments& moments, double value) {
+    moments.count += 1;
+    auto delta = value - moments.mean;
+    moments.mean += delta / moments.count;
+    moments.m2 += delta * (value - moments.mean);
+  }
+
+  static Moments merge(const Moments& a, const Moments& b) {
+    if (a.count == 0) {
+      return b;
+    }
+    if (b.count == 0) {
+      return a;
+    }
+
+    Moments merged;
+    merged.count = a.count + b.count;
+    auto delta = b.mean - a.mean;
+    merged.mean = a.mean + delta * (b.count / merged.count);
+    merged.m2 = a.m2 + b.m2 + delta * delta * (a.count * b.count / merged.count);
+    return merged;
+  }
+};
+
+#endif
@@ -2,13 +2,44 @@
 #define KIWI_PARSING_AST_H
 
 #include "tokens.h"
+#include "math/dispatch.h"
+#include "tracing/runtimestats.h"
 #include "typing/serializer.h"
 #include "typing/value.h"
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+/// @brief Interns method names as dense ids, so a class can index its
+/// methods by id instead of by name.
+class MethodIds {
+ public:
+  static int get(const k_string& name) {
+    std::lock_guard<std::mutex> lock(idMutex);
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+      return it->second;
+    }
+
+    auto id = static_cast<int>(ids.size());
+    ids.emplace(name, id);
+    return id;
+  }
+
+  static int getCtor() {
+    static const int ctor = get(Keywords.New);
+    return ctor;
+  }
+
+ private:
+  inline static std::unordered_map<k_string, int> ids;
+  inline static std::mutex idMutex;
+};
+
 enum class ASTNodeType {
   ASSIGNMENT,
   BINARY_OPERATION,
@@ -58,7 +89,9 @@ class ASTNode {
   ASTNodeType type;
   Token token = Token::createEmpty();
 
-  ASTNode(ASTNodeType type) : type(type) {}
+  ASTNode(ASTNodeType type) : type(type) {
+    RuntimeStats::increment(RuntimeCounter::ParsedNodes);
+  }
   virtual ~ASTNode() = default;
 
   virtual void print(int depth = 0) const = 0;
@@ -260,6 +293,11 @@ class ReturnNode : public ASTNode {
   std::unique_ptr<ASTNode> returnValue;
   std::unique_ptr<ASTNode> condition;
 
+  /// @brief Whether this returns a function call, possibly chosen by a
+  /// ternary, from a function body outside of any `try`, so the call can
+  /// reuse the returning frame.
+  bool isTailCall = false;
+
   ReturnNode() : ASTNode(ASTNodeType::RETURN_STATEMENT) {}
   ReturnNode(std::unique_ptr<ASTNode> returnValue,
              std::unique_ptr<ASTNode> condition)
@@ -509,6 +547,7 @@ class IdentifierNode : public ASTNode {
  public:
   k_string name;
   k_string package;
+  SlotCache slotCache;
 
   IdentifierNode() : ASTNode(ASTNodeType::IDENTIFIER) {}
   IdentifierNode(const k_string& name)
@@ -555,6 +594,7 @@ class BinaryOperationNode : public ASTNode {
   std::unique_ptr<ASTNode> left;
   KName op;
   std::unique_ptr<ASTNode> right;
+  BinaryOpCache opCache;
 
   BinaryOperationNode() : ASTNode(ASTNodeType::BINARY_OPERATION) {}
   BinaryOperationNode(std::unique_ptr<ASTNode> left, const KName& op,
@@ -793,12 +833,110 @@ class CaseWhenNode : public ASTNode {
   }
 };
 
+/// @brief Maps the literal values of a case statement's `when` clauses to
+/// the first clause that matches each value.
+///
+/// Integers in a narrow range index a vector directly; other values go
+/// through a hash table. A table is only built when every `when` is a
+/// scalar literal, which cannot have side effects when evaluated.
+class CaseJumpTable {
+ public:
+  static constexpr size_t NoMatch = static_cast<size_t>(-1);
+
+  /// @brief Builds a table for the clauses, or returns null when a clause is
+  /// not a scalar literal.
+  static std::unique_ptr<CaseJumpTable> build(
+      const std::vector<std::unique_ptr<CaseWhenNode>>& whenNodes) {
+    auto table = std::make_unique<CaseJumpTable>();
+    bool allIntegers = true;
+    k_int low = 0;
+    k_int high = 0;
+
+    for (size_t i = 0; i < whenNodes.size(); ++i) {
+      const auto* condition = whenNodes[i]->condition.get();
+      if (!condition || condition->type != ASTNodeType::LITERAL) {
+        return nullptr;
+      }
+
+      const auto& value = static_cast<const LiteralNode*>(condition)->value;
+      if (!isScalar(value)) {
+        return nullptr;
+      }
+
+      // The first clause for a value wins, as in a linear scan.
+      table->sparse.emplace(value, i);
+
+      if (!std::holds_alternative<k_int>(value)) {
+        allIntegers = false;
+        continue;
+      }
+
+      auto number = std::get<k_int>(value);
+      low = i == 0 ? number : std::min(low, number);
+      high = i == 0 ? number : std::max(high, number);
+    }
+
+    auto span = static_cast<unsigned long long>(high) -
+                static_cast<unsigned long long>(low);
+    if (allIntegers && !whenNodes.empty() &&
+        span < std::max<size_t>(MinDenseSpan, whenNodes.size() * 4)) {
+      table->base = low;
+      table->dense.assign(static_cast<size_t>(span) + 1, NoMatch);
+      for (const auto& [value, index] : table->sparse) {
+        table->dense[static_cast<unsigned long long>(std::get<k_int>(value)) -
+                     static_cast<unsigned long long>(low)] = index;
+      }
+      table->sparse.clear();
+    }
+
+    return table;
+  }
+
+  /// @brief Returns the index of the clause matching a value, or `NoMatch`.
+  size_t find(const k_value& value) const {
+    if (!dense.empty()) {
+      if (!std::holds_alternative<k_int>(value)) {
+        return NoMatch;
+      }
+
+      auto offset = static_cast<unsigned long long>(std::get<k_int>(value)) -
+                    static_cast<unsigned long long>(base);
+      return offset < dense.size() ? dense[offset] : NoMatch;
+    }
+
+    if (!isScalar(value)) {
+      return NoMatch;
+    }
+
+    auto it = sparse.find(value);
+    return it == sparse.end() ? NoMatch : it->second;
+  }
+
+ private:
+  static constexpr size_t MinDenseSpan = 64;
+
+  k_int base = 0;
+  std::vector<size_t> dense;
+  std::unordered_map<k_value, size_t> sparse;
+
+  static bool isScalar(const k_value& value) {
+    return std::holds_alternative<k_int>(value) ||
+           std::holds_alternative<double>(value) ||
+           std::holds_alternative<bool>(value) ||
+           std::holds_alternative<k_string>(value);
+  }
+};
+
 class CaseNode : public ASTNode {
  public:
   std::unique_ptr<ASTNode> testValue;
   std::vector<std::unique_ptr<ASTNode>> elseBody;
   std::vector<std::unique_ptr<CaseWhenNode>> whenNodes;
 
+  // Built the first time the case statement runs with a test value.
+  mutable std::once_flag jumpTableOnce;
+  mutable std::unique_ptr<CaseJumpTable> jumpTable;
+
   CaseNode() : ASTNode(ASTNodeType::CASE_STATEMENT) {}
 
   void print(int depth) const override {
@@ -922,6 +1060,7 @@ class FunctionCallNode : public ASTNode {
   k_string functionName;
   KName op;
   std::vector<std::unique_ptr<ASTNode>> arguments;
+  int methodId = -1;
 
   FunctionCallNode() : ASTNode(ASTNodeType::FUNCTION_CALL) {}
   FunctionCallNode(const k_string& functionName, const KName& op,
@@ -929,7 +1068,8 @@ class FunctionCallNode : public ASTNode {
       : ASTNode(ASTNodeType::FUNCTION_CALL),
         functionName(functionName),
         op(op),
-        arguments(std::move(arguments)) {}
+        arguments(std::move(arguments)),
+        methodId(MethodIds::get(functionName)) {}
 
   void print(int depth) const override {
     print_depth(depth);
@@ -971,6 +1111,7 @@ class MethodCallNode : public ASTNode {
   k_string methodName;
   KName op;
   std::vector<std::unique_ptr<ASTNode>> arguments;
+  int methodId;
 
   MethodCallNode(std::unique_ptr<ASTNode> object, const k_string& methodName,
                  const KName& op,
@@ -979,7 +1120,8 @@ class MethodCallNode : public ASTNode {
         object(std::move(object)),
         methodName(methodName),
         op(op),
-        arguments(std::move(arguments)) {}
+        arguments(std::move(arguments)),
+        methodId(MethodIds::get(methodName)) {}
 
   void print(int depth) const override {
     print_depth(depth);
@@ -1014,6 +1156,7 @@ class MemberAccessNode : public ASTNode {
 class SelfNode : public ASTNode {
  public:
   k_string name;
+  SlotCache slotCache;
   SelfNode() : ASTNode(ASTNodeType::SELF) {}
   SelfNode(const k_string& name) : ASTNode(ASTNodeType::SELF), name(name) {}
 
@@ -1060,6 +1203,7 @@ class AssignmentNode : public ASTNode {
   k_string name;
   KName op;
   std::unique_ptr<ASTNode> initializer;
+  SlotCache slotCache;
 
   AssignmentNode() : ASTNode(ASTNodeType::ASSIGNMENT) {}
   AssignmentNode(std::unique_ptr<ASTNode> left, const k_string& name,
@@ -1115,14 +1259,34 @@ enum class KCallableType {
   Lambda,
 };
 
+/// @brief How a call binds its arguments to a callable's parameters, worked
+/// out once when the callable is defined.
+struct CallDescriptor {
+  /// @brief The number of parameters.
+  size_t arity = 0;
+
+  /// @brief The number of arguments a call must pass. The parameters after
+  /// the last one without a default value may be left out.
+  size_t requiredArity = 0;
+};
+
 class KCallable {
  public:
   KCallableType type;
   std::vector<std::pair<k_string, k_value>> parameters;
-  std::unordered_set<k_string> defaultParameters;
+  CallDescriptor call;
   KCallable(KCallableType type) : type(type) {}
   virtual ~KCallable() = default;
   virtual const std::vector<std::unique_ptr<ASTNode>>& getBody() const = 0;
+
+  /// @brief Sets the parameters, each paired with its default value, and
+  /// the number of arguments a call must pass.
+  void setParameters(std::vector<std::pair<k_string, k_value>> params,
+                     size_t requiredArity) {
+    parameters = std::move(params);
+    call.arity = parameters.size();
+    call.requiredArity = requiredArity;
+  }
 };
 
 class KBuiltin : public KCallable {
@@ -1174,6 +1338,36 @@ class KClass {
   k_string name;
   k_string baseClass;
   std::unordered_map<k_string, std::unique_ptr<KFunction>> methods;
+
+  /// @brief Builds the method table from the base class's table and this
+  /// class's own methods, so inherited methods are found in one step. It is
+  /// called again whenever the base class is redefined.
+  void finalize(const KClass* base) {
+    vtable.clear();
+    if (base) {
+      vtable = base->vtable;
+    }
+
+    for (const auto& method : methods) {
+      if (!method.second) {
+        continue;
+      }
+
+      auto id = static_cast<size_t>(MethodIds::get(method.first));
+      if (id >= vtable.size()) {
+        vtable.resize(id + 1, nullptr);
+      }
+      vtable[id] = method.second.get();
+    }
+  }
+
+  const KFunction* findMethod(int id) const {
+    auto index = static_cast<size_t>(id);
+    return index < vtable.size() ? vtable[index] : nullptr;
+  }
+
+ private:
+  std::vector<const KFunction*> vtable;
 };
 
 class KPackage {
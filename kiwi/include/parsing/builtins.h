@@ -238,6 +238,17 @@ struct {
   const k_string Divisors = "__divisors__";
   const k_string ListPrimes = "__listprimes__";
   const k_string NthPrime = "__nthprime__";
+  const k_string CountPrimes = "__countprimes__";
+  const k_string Mean = "__mean__";
+  const k_string Variance = "__variance__";
+  const k_string StdDev = "__stddev__";
+  const k_string Median = "__median__";
+  const k_string Quantile = "__quantile__";
+  const k_string Histogram = "__histogram__";
+  const k_string CumSum = "__cumsum__";
+  const k_string ArgMin = "__argmin__";
+  const k_string ArgMax = "__argmax__";
+  const k_string PowMod = "__powmod__";
 
   std::unordered_set<k_string> builtins = {
       Sin,        Tan,      Asin,      Acos,       Atan,       Atan2,
@@ -247,7 +258,9 @@ struct {
       Ceil,       Round,    Trunc,     Remainder,  Exp,        ExpM1,
       Erf,        ErfC,     LGamma,    TGamma,     FMax,       FMin,
       FDim,       CopySign, NextAfter, Pow,        Epsilon,    Random,
-      ListPrimes, NthPrime, Divisors,  RotateLeft, RotateRight};
+      ListPrimes, NthPrime, Divisors,  RotateLeft, RotateRight, Mean,
+      Variance,   StdDev,   Median,    Quantile,   Histogram,  CumSum,
+      ArgMin,     ArgMax,   PowMod,    CountPrimes};
 
   std::unordered_set<KName> st_builtins = {
       KName::Builtin_Math_Abs,        KName::Builtin_Math_Acos,
@@ -273,7 +286,12 @@ struct {
       KName::Builtin_Math_Tanh,       KName::Builtin_Math_TGamma,
       KName::Builtin_Math_Trunc,      KName::Builtin_Math_ListPrimes,
       KName::Builtin_Math_NthPrime,   KName::Builtin_Math_RotateLeft,
-      KName::Builtin_Math_RotateRight};
+      KName::Builtin_Math_RotateRight, KName::Builtin_Math_Mean,
+      KName::Builtin_Math_Variance,   KName::Builtin_Math_StdDev,
+      KName::Builtin_Math_Median,     KName::Builtin_Math_Quantile,
+      KName::Builtin_Math_Histogram,  KName::Builtin_Math_CumSum,
+      KName::Builtin_Math_ArgMin,     KName::Builtin_Math_ArgMax,
+      KName::Builtin_Math_PowMod,     KName::Builtin_Math_CountPrimes};
 
   bool is_builtin(const k_string& arg) {
     return builtins.find(arg) != builtins.end();
@@ -284,6 +302,51 @@ struct {
   }
 } MathBuiltins;
 
+struct {
+  const k_string New = "__matrix__";
+  const k_string FromList = "__matrix_from__";
+  const k_string ToList = "__matrix_tolist__";
+  const k_string Shape = "__matrix_shape__";
+  const k_string Get = "__matrix_get__";
+  const k_string Set = "__matrix_set__";
+  const k_string Slice = "__matrix_slice__";
+  const k_string Add = "__matrix_add__";
+  const k_string Subtract = "__matrix_sub__";
+  const k_string Multiply = "__matrix_mul__";
+  const k_string Divide = "__matrix_div__";
+  const k_string Equal = "__matrix_eq__";
+  const k_string Sum = "__matrix_sum__";
+  const k_string Min = "__matrix_min__";
+  const k_string Max = "__matrix_max__";
+  const k_string Transpose = "__matrix_transpose__";
+  const k_string MatMul = "__matrix_matmul__";
+  const k_string Convolve = "__matrix_convolve__";
+
+  std::unordered_set<k_string> builtins = {
+      New,    FromList, ToList,   Shape,    Get,       Set,
+      Slice,  Add,      Subtract, Multiply, Divide,    Equal,
+      Sum,    Min,      Max,      Transpose, MatMul,   Convolve};
+
+  std::unordered_set<KName> st_builtins = {
+      KName::Builtin_Matrix_New,      KName::Builtin_Matrix_FromList,
+      KName::Builtin_Matrix_ToList,   KName::Builtin_Matrix_Shape,
+      KName::Builtin_Matrix_Get,      KName::Builtin_Matrix_Set,
+      KName::Builtin_Matrix_Slice,    KName::Builtin_Matrix_Add,
+      KName::Builtin_Matrix_Subtract, KName::Builtin_Matrix_Multiply,
+      KName::Builtin_Matrix_Divide,   KName::Builtin_Matrix_Equal,
+      KName::Builtin_Matrix_Sum,      KName::Builtin_Matrix_Min,
+      KName::Builtin_Matrix_Max,      KName::Builtin_Matrix_Transpose,
+      KName::Builtin_Matrix_MatMul,   KName::Builtin_Matrix_Convolve};
+
+  bool is_builtin(const k_string& arg) {
+    return builtins.find(arg) != builtins.end();
+  }
+
+  bool is_builtin(const KName& arg) {
+    return st_builtins.find(arg) != st_builtins.end();
+  }
+} MatrixBuiltins;
+
 struct {
   const k_string Deserialize = "deserialize";
   const k_string Serialize = "serialize";
@@ -306,11 +369,18 @@ struct {
 struct {
   const k_string RInspect = "__rinspect__";
   const k_string RList = "__rlist__";
+  const k_string MemStats = "__memstats__";
+  const k_string RtStats = "__rtstats__";
+  const k_string Collect = "__gc__";
 
-  std::unordered_set<k_string> builtins = {RInspect, RList};
+  std::unordered_set<k_string> builtins = {RInspect, RList, MemStats, RtStats,
+                                           Collect};
 
   std::unordered_set<KName> st_builtins = {KName::Builtin_Reflector_RInspect,
-                                           KName::Builtin_Reflector_RList};
+                                           KName::Builtin_Reflector_RList,
+                                           KName::Builtin_Reflector_MemStats,
+                                           KName::Builtin_Reflector_RtStats,
+                                           KName::Builtin_Reflector_Collect};
 
   bool is_builtin(const k_string& arg) {
     return builtins.find(arg) != builtins.end();
@@ -421,15 +491,16 @@ struct {
   const k_string Patch = "__webc_patch__";
   const k_string Head = "__webc_head__";
   const k_string Options = "__webc_options__";
+  const k_string Batch = "__webc_batch__";
 
-  std::unordered_set<k_string> builtins = {Get,   Post, Put,    Delete,
-                                           Patch, Head, Options};
+  std::unordered_set<k_string> builtins = {Get,   Post, Put,     Delete,
+                                           Patch, Head, Options, Batch};
 
   std::unordered_set<KName> st_builtins = {
-      KName::Builtin_WebClient_Delete, KName::Builtin_WebClient_Get,
-      KName::Builtin_WebClient_Head,   KName::Builtin_WebClient_Options,
-      KName::Builtin_WebClient_Patch,  KName::Builtin_WebClient_Post,
-      KName::Builtin_WebClient_Put};
+      KName::Builtin_WebClient_Batch,   KName::Builtin_WebClient_Delete,
+      KName::Builtin_WebClient_Get,     KName::Builtin_WebClient_Head,
+      KName::Builtin_WebClient_Options, KName::Builtin_WebClient_Patch,
+      KName::Builtin_WebClient_Post,    KName::Builtin_WebClient_Put};
 
   bool is_builtin(const k_string& arg) {
     return builtins.find(arg) != builtins.end();
@@ -670,6 +741,7 @@ struct {
     return ConsoleBuiltins.is_builtin(arg) || EnvBuiltins.is_builtin(arg) ||
            ArgvBuiltins.is_builtin(arg) || TimeBuiltins.is_builtin(arg) ||
            FileIOBuiltIns.is_builtin(arg) || MathBuiltins.is_builtin(arg) ||
+           MatrixBuiltins.is_builtin(arg) ||
            PackageBuiltins.is_builtin(arg) || SysBuiltins.is_builtin(arg) ||
            HttpBuiltins.is_builtin(arg) || WebServerBuiltins.is_builtin(arg) ||
            LoggingBuiltins.is_builtin(arg) || EncoderBuiltins.is_builtin(arg) ||
@@ -681,6 +753,7 @@ struct {
     return ConsoleBuiltins.is_builtin(arg) || EnvBuiltins.is_builtin(arg) ||
            ArgvBuiltins.is_builtin(arg) || TimeBuiltins.is_builtin(arg) ||
            FileIOBuiltIns.is_builtin(arg) || MathBuiltins.is_builtin(arg) ||
+           MatrixBuiltins.is_builtin(arg) ||
            PackageBuiltins.is_builtin(arg) || SysBuiltins.is_builtin(arg) ||
            HttpBuiltins.is_builtin(arg) || WebServerBuiltins.is_builtin(arg) ||
            LoggingBuiltins.is_builtin(arg) || EncoderBuiltins.is_builtin(arg) ||
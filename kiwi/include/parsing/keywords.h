@@ -322,9 +322,10 @@ struct {
   const k_string Object = "Object";
   const k_string With = "Lambda";
   const k_string None = "None";
+  const k_string Matrix = "Matrix";
 
   std::unordered_set<k_string> typenames = {
-      Integer, Double, Boolean, String, List, Hash, Object, With, None};
+      Integer, Double, Boolean, String, List, Hash, Object, With, None, Matrix};
 
   bool is_typename(const k_string& arg) {
     return typenames.find(arg) != typenames.end();
@@ -16,7 +16,7 @@ class Lexer {
  public:
   Lexer(const std::string& file, const std::string& source, bool skipWS = true)
       : source(source), pos(0), skipWS(skipWS), row(0), col(0) {
-    fileId = FileRegistry::getInstance().registerFile(file);
+    fileId = FileRegistry::getInstance().registerFile(file, source);
     preprocessSource();
   }
 
@@ -554,6 +554,8 @@ class Lexer {
       st = KName::Types_Lambda;
     } else if (typeName == TypeNames.List) {
       st = KName::Types_List;
+    } else if (typeName == TypeNames.Matrix) {
+      st = KName::Types_Matrix;
     } else if (typeName == TypeNames.Object) {
       st = KName::Types_Object;
     } else if (typeName == TypeNames.String) {
@@ -612,6 +614,12 @@ class Lexer {
       st = KName::Builtin_Reflector_RInspect;
     } else if (builtin == ReflectorBuiltins.RList) {
       st = KName::Builtin_Reflector_RList;
+    } else if (builtin == ReflectorBuiltins.MemStats) {
+      st = KName::Builtin_Reflector_MemStats;
+    } else if (builtin == ReflectorBuiltins.RtStats) {
+      st = KName::Builtin_Reflector_RtStats;
+    } else if (builtin == ReflectorBuiltins.Collect) {
+      st = KName::Builtin_Reflector_Collect;
     }
 
     return createToken(KTokenType::IDENTIFIER, st, builtin);
@@ -832,6 +840,72 @@ class Lexer {
       st = KName::Builtin_Math_ListPrimes;
     } else if (builtin == MathBuiltins.NthPrime) {
       st = KName::Builtin_Math_NthPrime;
+    } else if (builtin == MathBuiltins.CountPrimes) {
+      st = KName::Builtin_Math_CountPrimes;
+    } else if (builtin == MathBuiltins.Mean) {
+      st = KName::Builtin_Math_Mean;
+    } else if (builtin == MathBuiltins.Variance) {
+      st = KName::Builtin_Math_Variance;
+    } else if (builtin == MathBuiltins.StdDev) {
+      st = KName::Builtin_Math_StdDev;
+    } else if (builtin == MathBuiltins.Median) {
+      st = KName::Builtin_Math_Median;
+    } else if (builtin == MathBuiltins.Quantile) {
+      st = KName::Builtin_Math_Quantile;
+    } else if (builtin == MathBuiltins.Histogram) {
+      st = KName::Builtin_Math_Histogram;
+    } else if (builtin == MathBuiltins.CumSum) {
+      st = KName::Builtin_Math_CumSum;
+    } else if (builtin == MathBuiltins.ArgMin) {
+      st = KName::Builtin_Math_ArgMin;
+    } else if (builtin == MathBuiltins.ArgMax) {
+      st = KName::Builtin_Math_ArgMax;
+    } else if (builtin == MathBuiltins.PowMod) {
+      st = KName::Builtin_Math_PowMod;
+    }
+
+    return createToken(KTokenType::IDENTIFIER, st, builtin);
+  }
+
+  Token parseMatrixBuiltin(const std::string& builtin) {
+    auto st = KName::Default;
+
+    if (builtin == MatrixBuiltins.New) {
+      st = KName::Builtin_Matrix_New;
+    } else if (builtin == MatrixBuiltins.FromList) {
+      st = KName::Builtin_Matrix_FromList;
+    } else if (builtin == MatrixBuiltins.ToList) {
+      st = KName::Builtin_Matrix_ToList;
+    } else if (builtin == MatrixBuiltins.Shape) {
+      st = KName::Builtin_Matrix_Shape;
+    } else if (builtin == MatrixBuiltins.Get) {
+      st = KName::Builtin_Matrix_Get;
+    } else if (builtin == MatrixBuiltins.Set) {
+      st = KName::Builtin_Matrix_Set;
+    } else if (builtin == MatrixBuiltins.Slice) {
+      st = KName::Builtin_Matrix_Slice;
+    } else if (builtin == MatrixBuiltins.Add) {
+      st = KName::Builtin_Matrix_Add;
+    } else if (builtin == MatrixBuiltins.Subtract) {
+      st = KName::Builtin_Matrix_Subtract;
+    } else if (builtin == MatrixBuiltins.Multiply) {
+      st = KName::Builtin_Matrix_Multiply;
+    } else if (builtin == MatrixBuiltins.Divide) {
+      st = KName::Builtin_Matrix_Divide;
+    } else if (builtin == MatrixBuiltins.Equal) {
+      st = KName::Builtin_Matrix_Equal;
+    } else if (builtin == MatrixBuiltins.Sum) {
+      st = KName::Builtin_Matrix_Sum;
+    } else if (builtin == MatrixBuiltins.Min) {
+      st = KName::Builtin_Matrix_Min;
+    } else if (builtin == MatrixBuiltins.Max) {
+      st = KName::Builtin_Matrix_Max;
+    } else if (builtin == MatrixBuiltins.Transpose) {
+      st = KName::Builtin_Matrix_Transpose;
+    } else if (builtin == MatrixBuiltins.MatMul) {
+      st = KName::Builtin_Matrix_MatMul;
+    } else if (builtin == MatrixBuiltins.Convolve) {
+      st = KName::Builtin_Matrix_Convolve;
     }
 
     return createToken(KTokenType::IDENTIFIER, st, builtin);
@@ -878,6 +952,8 @@ class Lexer {
       st = KName::Builtin_WebClient_Options;
     } else if (builtin == HttpBuiltins.Patch) {
       st = KName::Builtin_WebClient_Patch;
+    } else if (builtin == HttpBuiltins.Batch) {
+      st = KName::Builtin_WebClient_Batch;
     }
 
     return createToken(KTokenType::IDENTIFIER, st, builtin);
@@ -984,6 +1060,8 @@ class Lexer {
       return parseListBuiltin(builtin);
     } else if (MathBuiltins.is_builtin(builtin)) {
       return parseMathBuiltin(builtin);
+    } else if (MatrixBuiltins.is_builtin(builtin)) {
+      return parseMatrixBuiltin(builtin);
     } else if (PackageBuiltins.is_builtin(builtin)) {
       return parsePackageBuiltin(builtin);
     } else if (SysBuiltins.is_builtin(builtin)) {
@@ -1217,7 +1295,13 @@ class Lexer {
     } else {
       std::istringstream ss(literal);
       k_int value;
-      ss >> value;
+      if (!(ss >> value)) {
+        // Too large for a k_int.
+        BigInt bigValue;
+        BigInt::parse(literal, bigValue);
+        return createToken(KTokenType::LITERAL, KName::Default, literal,
+                           make_integer(std::move(bigValue)));
+      }
       return createToken(KTokenType::LITERAL, KName::Default, literal, value);
     }
   }
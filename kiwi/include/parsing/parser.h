@@ -81,6 +81,8 @@ class Parser {
   std::unique_ptr<ASTNode> parseIdentifier();
   std::unique_ptr<ASTNode> parseQualifiedIdentifier(const k_string& prefix);
   std::unique_ptr<ASTNode> parsePrint();
+  void markTailCalls(const std::vector<std::unique_ptr<ASTNode>>& body);
+  bool hasTailCall(const ASTNode* expr);
 
   // Utility methods to help with token matching and advancing the stream
   // Instead of passing streams everywhere, I'm going to just keep it local to the parser.
@@ -451,6 +453,7 @@ std::unique_ptr<ASTNode> Parser::parseFunction() {
   next();  // Consume 'end'
 
   mangledNames.clear();
+  markTailCalls(body);
 
   auto functionDeclaration = std::make_unique<FunctionDeclarationNode>();
   functionDeclaration->name = functionName;
@@ -459,6 +462,72 @@ std::unique_ptr<ASTNode> Parser::parseFunction() {
   return functionDeclaration;
 }
 
+/// @brief Marks the returns of function calls that end a function body.
+/// Returns nested in conditionals and loops still end the body, but those
+/// in a `try` do not, since the `try` must see the call's errors.
+void Parser::markTailCalls(const std::vector<std::unique_ptr<ASTNode>>& body) {
+  for (const auto& stmt : body) {
+    switch (stmt->type) {
+      case ASTNodeType::RETURN_STATEMENT: {
+        auto returnNode = static_cast<ReturnNode*>(stmt.get());
+        returnNode->isTailCall =
+            returnNode->returnValue && hasTailCall(returnNode->returnValue.get());
+        break;
+      }
+
+      case ASTNodeType::IF_STATEMENT: {
+        auto ifNode = static_cast<const IfNode*>(stmt.get());
+        markTailCalls(ifNode->body);
+        for (const auto& elsif : ifNode->elseifNodes) {
+          markTailCalls(elsif->body);
+        }
+        markTailCalls(ifNode->elseBody);
+        break;
+      }
+
+      case ASTNodeType::CASE_STATEMENT: {
+        auto caseNode = static_cast<const CaseNode*>(stmt.get());
+        for (const auto& when : caseNode->whenNodes) {
+          markTailCalls(when->body);
+        }
+        markTailCalls(caseNode->elseBody);
+        break;
+      }
+
+      case ASTNodeType::FOR_LOOP:
+        markTailCalls(static_cast<const ForLoopNode*>(stmt.get())->body);
+        break;
+
+      case ASTNodeType::WHILE_LOOP:
+        markTailCalls(static_cast<const WhileLoopNode*>(stmt.get())->body);
+        break;
+
+      case ASTNodeType::REPEAT_LOOP:
+        markTailCalls(static_cast<const RepeatLoopNode*>(stmt.get())->body);
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+/// @brief Checks whether an expression ends in a function call, either
+/// directly or in a branch of a ternary.
+bool Parser::hasTailCall(const ASTNode* expr) {
+  if (expr->type == ASTNodeType::FUNCTION_CALL) {
+    return true;
+  }
+
+  if (expr->type == ASTNodeType::TERNARY_OPERATION) {
+    auto ternary = static_cast<const TernaryOperationNode*>(expr);
+    return hasTailCall(ternary->trueExpression.get()) ||
+           hasTailCall(ternary->falseExpression.get());
+  }
+
+  return false;
+}
+
 std::unique_ptr<ASTNode> Parser::parseForLoop() {
   matchSubType(KName::KW_For);  // Consume 'for'
 
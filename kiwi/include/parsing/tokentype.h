@@ -157,6 +157,7 @@ enum KName {
   Builtin_Logging_Warn,
   Builtin_Logging_Info,
   Builtin_Logging_Error,
+  Builtin_WebClient_Batch,
   Builtin_WebClient_Delete,
   Builtin_WebClient_Get,
   Builtin_WebClient_Head,
@@ -217,11 +218,43 @@ enum KName {
   Builtin_Math_Trunc,
   Builtin_Math_ListPrimes,
   Builtin_Math_NthPrime,
+  Builtin_Math_CountPrimes,
+  Builtin_Math_Mean,
+  Builtin_Math_Variance,
+  Builtin_Math_StdDev,
+  Builtin_Math_Median,
+  Builtin_Math_Quantile,
+  Builtin_Math_Histogram,
+  Builtin_Math_CumSum,
+  Builtin_Math_ArgMin,
+  Builtin_Math_ArgMax,
+  Builtin_Math_PowMod,
+  Builtin_Matrix_New,
+  Builtin_Matrix_FromList,
+  Builtin_Matrix_ToList,
+  Builtin_Matrix_Shape,
+  Builtin_Matrix_Get,
+  Builtin_Matrix_Set,
+  Builtin_Matrix_Slice,
+  Builtin_Matrix_Add,
+  Builtin_Matrix_Subtract,
+  Builtin_Matrix_Multiply,
+  Builtin_Matrix_Divide,
+  Builtin_Matrix_Equal,
+  Builtin_Matrix_Sum,
+  Builtin_Matrix_Min,
+  Builtin_Matrix_Max,
+  Builtin_Matrix_Transpose,
+  Builtin_Matrix_MatMul,
+  Builtin_Matrix_Convolve,
   Builtin_Package_Home,
   Builtin_Reflector_RBin,
   Builtin_Reflector_RInspect,
   Builtin_Reflector_RLib,
   Builtin_Reflector_RList,
+  Builtin_Reflector_MemStats,
+  Builtin_Reflector_RtStats,
+  Builtin_Reflector_Collect,
   Builtin_Serializer_Serialize,
   Builtin_Serializer_Deserialize,
   Builtin_Sys_EffectiveUserId,
@@ -328,6 +361,7 @@ enum KName {
   Types_Integer,
   Types_Lambda,
   Types_List,
+  Types_Matrix,
   Types_None,
   Types_Object,
   Types_String,
@@ -1,24 +1,39 @@
 #ifndef KIWI_STACKFRAME_H
 #define KIWI_STACKFRAME_H
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <new>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 #include "parsing/tokens.h"
 #include "tracing/error.h"
+#include "tracing/memstats.h"
 #include "tracing/state.h"
 #include "typing/value.h"
+#include "util/sys.h"
 
 enum class FrameFlags : uint16_t {
   None = 0,
-  Return = 1 << 0,
-  SubFrame = 1 << 1,
-  InLoop = 1 << 2,
-  Break = 1 << 3,
-  Next = 1 << 4,
-  InTry = 1 << 5,
-  InObject = 1 << 6,
+  SubFrame = 1 << 0,
+  InTry = 1 << 1,
+  InObject = 1 << 2,
+};
+
+/// @brief How the statement last run in a frame completed. Any completion
+/// other than `Normal` skips the rest of each enclosing block up to the
+/// construct that handles it: a loop for `Break` and `Next`, a `try` for
+/// `Throw`, and the function body for `Return` and `TailCall`.
+enum class Completion : uint8_t {
+  Normal,
+  Break,
+  Next,
+  Return,
+  TailCall,
+  Throw,
 };
 
 inline FrameFlags operator|(FrameFlags a, FrameFlags b) {
@@ -36,11 +51,16 @@ inline FrameFlags operator~(FrameFlags a) {
       ~static_cast<std::underlying_type_t<FrameFlags>>(a));
 }
 
-struct CallStackFrame {
+struct CallStackFrame : MemoryTracked<MemoryKind::Frame> {
   std::unordered_map<k_string, k_value> variables;
   k_value returnValue;
   k_object objectContext;
   FrameFlags flags = FrameFlags::None;
+  Completion completion = Completion::Normal;
+
+  /// @brief The loops and `try` blocks running in this frame.
+  uint16_t loopDepth = 0;
+  uint16_t tryDepth = 0;
 
   CallStackFrame() {}
   ~CallStackFrame() { variables.clear(); }
@@ -59,6 +79,179 @@ struct CallStackFrame {
   void setFlag(FrameFlags flag) { flags = flags | flag; }
   void clearFlag(FrameFlags flag) { flags = flags & ~flag; }
   bool isFlagSet(FrameFlags flag) const { return (flags & flag) == flag; }
+
+  bool isAbrupt() const { return completion != Completion::Normal; }
+};
+
+/// @brief Sets a frame's loop or `try` depth while in scope, and restores
+/// it on exit, including when an error unwinds the scope.
+class FrameDepthScope {
+ public:
+  FrameDepthScope(uint16_t& depth, uint16_t value)
+      : depth(depth), saved(depth) {
+    depth = value;
+  }
+  ~FrameDepthScope() { depth = saved; }
+
+  FrameDepthScope(const FrameDepthScope&) = delete;
+  FrameDepthScope& operator=(const FrameDepthScope&) = delete;
+
+ private:
+  uint16_t& depth;
+  uint16_t saved;
+};
+
+/// @brief Keeps the memory of dropped call frames for reuse by later calls.
+///
+/// Every call creates a frame and drops it on return, so each thread keeps a
+/// free list of frame-sized blocks and hands them back out instead of going
+/// through the global allocator. A block may be freed on another thread than
+/// the one that allocated it; it joins that thread's list.
+class FramePool {
+ public:
+  /// @brief Room for a frame and the reference counts stored beside it.
+  static constexpr size_t BlockSize =
+      sizeof(CallStackFrame) + 4 * sizeof(void*);
+  static constexpr size_t MaxCached = 1024;
+
+  static void* allocate(size_t bytes) {
+    if (bytes > BlockSize || closed) {
+      return ::operator new(bytes);
+    }
+
+    if (auto block = head) {
+      head = block->next;
+      --cached;
+      return block;
+    }
+
+    return ::operator new(BlockSize);
+  }
+
+  static void deallocate(void* pointer, size_t bytes) {
+    if (bytes > BlockSize || closed || cached >= MaxCached) {
+      ::operator delete(pointer);
+      return;
+    }
+
+    // Frees the thread's list when the thread exits.
+    thread_local Releaser releaser;
+
+    auto block = static_cast<Block*>(pointer);
+    block->next = head;
+    head = block;
+    ++cached;
+  }
+
+ private:
+  struct Block {
+    Block* next;
+  };
+
+  struct Releaser {
+    ~Releaser() {
+      while (head) {
+        auto block = head;
+        head = block->next;
+        ::operator delete(block);
+      }
+      cached = 0;
+      closed = true;
+    }
+  };
+
+  inline static thread_local Block* head = nullptr;
+  inline static thread_local size_t cached = 0;
+  inline static thread_local bool closed = false;
+};
+
+/// @brief Allocates from the frame pool, for `allocate_shared`.
+template <typename T>
+struct FrameAllocator {
+  using value_type = T;
+
+  FrameAllocator() {}
+
+  template <typename U>
+  FrameAllocator(const FrameAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(FramePool::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* pointer, size_t n) {
+    FramePool::deallocate(pointer, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const FrameAllocator<U>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const FrameAllocator<U>&) const {
+    return false;
+  }
+};
+
+inline std::shared_ptr<CallStackFrame> make_frame() {
+  return std::allocate_shared<CallStackFrame>(
+      FrameAllocator<CallStackFrame>());
+}
+
+/// @brief The interpreter's call stack, held in one contiguous array.
+///
+/// The stack is limited to a maximum depth, and it also stops short of the
+/// end of the thread's native stack, so that runaway recursion raises a
+/// `StackOverflowError` instead of crashing the interpreter.
+class FrameStack {
+ public:
+  using Frame = std::shared_ptr<CallStackFrame>;
+
+  static constexpr size_t DefaultMaxDepth = 100000;
+
+  /// @brief The native stack the CLI runs scripts on, where the platform
+  /// allows it. A typical 8 MB stack only holds a few thousand calls.
+  static constexpr size_t InterpreterStackSize = 128 * 1024 * 1024;
+
+  /// @brief The native stack kept free below the deepest frame, for the
+  /// work done within a frame.
+  static constexpr uintptr_t NativeStackReserve = 128 * 1024;
+
+  FrameStack() { frames.reserve(256); }
+
+  static void setMaxDepth(size_t depth) { maxDepth = depth; }
+  static size_t getMaxDepth() { return maxDepth; }
+
+  bool empty() const { return frames.empty(); }
+  size_t size() const { return frames.size(); }
+  const Frame& top() const { return frames.back(); }
+
+  void push(const Frame& frame) { frames.push_back(frame); }
+  void pop() { frames.pop_back(); }
+
+  /// @brief Checks whether the stack has grown past its limits.
+  bool isOverflowing() const {
+    return frames.size() > maxDepth || isNativeStackLow();
+  }
+
+  std::vector<Frame>::const_iterator begin() const { return frames.begin(); }
+  std::vector<Frame>::const_iterator end() const { return frames.end(); }
+
+ private:
+  inline static size_t maxDepth = DefaultMaxDepth;
+  inline static thread_local uintptr_t nativeStackLimit = 0;
+
+  std::vector<Frame> frames;
+
+  static bool isNativeStackLow() {
+    if (nativeStackLimit == 0) {
+      nativeStackLimit = Sys::getStackLowAddress() + NativeStackReserve;
+    }
+
+    char marker;
+    return reinterpret_cast<uintptr_t>(&marker) < nativeStackLimit;
+  }
 };
 
 #endif
\ No newline at end of file
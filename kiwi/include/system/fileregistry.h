@@ -17,8 +17,8 @@ class FileRegistry {
   FileRegistry(const FileRegistry&) = delete;
   FileRegistry& operator=(const FileRegistry&) = delete;
 
-  int registerFile(const std::string& filePath) {
-    std::istringstream stream(filePath);
+  int registerFile(const std::string& filePath, const std::string& content) {
+    std::istringstream stream(content);
     std::vector<std::string> lines;
     std::string line;
     while (std::getline(stream, line)) {
@@ -0,0 +1,287 @@
+#ifndef KIWI_TRACING_CHROMETRACE_H
+#define KIWI_TRACING_CHROMETRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN64
+#include <csignal>
+#include <pthread.h>
+#endif
+
+/// @brief Records spans and writes them as Chrome trace events.
+///
+/// Each thread appends to its own buffer, a chain of fixed-size chunks. Only
+/// the owning thread writes to a buffer, and it publishes each event with a
+/// release store of the chunk size, so recording never takes a lock. The
+/// writer reads the buffers with acquire loads when the trace is flushed.
+class TraceRecorder {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static TraceRecorder& getInstance() {
+    static TraceRecorder instance;
+    return instance;
+  }
+
+  TraceRecorder(const TraceRecorder&) = delete;
+  TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+  static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+  /// @brief Gets the minimum duration of a function call span.
+  static int64_t getCallThresholdNanos() { return callThresholdNanos; }
+
+  static void setCallThreshold(int64_t micros) {
+    callThresholdNanos = micros * 1000;
+  }
+
+  void start(const std::string& path) {
+    if (isEnabled()) {
+      return;
+    }
+
+    outputPath = path;
+    startTime = Clock::now();
+    getThreadBuffer().name = "main";
+    enabled = true;
+
+    std::atexit([]() { TraceRecorder::getInstance().stop(); });
+    watchSignals();
+  }
+
+  void record(const char* category, const std::string& name,
+              Clock::time_point start, Clock::time_point end) {
+    getThreadBuffer().append(
+        {name, category, toNanos(start - startTime), toNanos(end - start)});
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> lock(bufferMutex);
+
+    if (!enabled.exchange(false)) {
+      return;
+    }
+
+    std::ofstream output(outputPath);
+    if (!output.is_open()) {
+      std::cerr << "Could not write trace to " << outputPath << std::endl;
+      return;
+    }
+
+    writeJson(output);
+  }
+
+ private:
+  struct Event {
+    std::string name;
+    const char* category;
+    int64_t startNanos;
+    int64_t durationNanos;
+  };
+
+  struct Chunk {
+    static constexpr size_t Capacity = 4096;
+
+    std::unique_ptr<Event[]> events{new Event[Capacity]};
+    std::atomic<size_t> size{0};
+    std::atomic<Chunk*> next{nullptr};
+  };
+
+  struct ThreadBuffer {
+    int id = 0;
+    std::string name;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    Chunk* head = nullptr;
+    Chunk* tail = nullptr;
+
+    void append(Event&& event) {
+      auto size = tail->size.load(std::memory_order_relaxed);
+
+      if (size == Chunk::Capacity) {
+        chunks.push_back(std::make_unique<Chunk>());
+        auto chunk = chunks.back().get();
+        tail->next.store(chunk, std::memory_order_release);
+        tail = chunk;
+        size = 0;
+      }
+
+      tail->events[size] = std::move(event);
+      tail->size.store(size + 1, std::memory_order_release);
+    }
+  };
+
+  inline static std::atomic<bool> enabled{false};
+  inline static int64_t callThresholdNanos = 1000000;
+
+  std::string outputPath;
+  Clock::time_point startTime;
+  std::mutex bufferMutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+  TraceRecorder() {}
+
+  static int64_t toNanos(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+        .count();
+  }
+
+  /// @brief Gets the buffer of the calling thread, registering it on first
+  /// use. Buffers outlive their threads so the trace can be written later.
+  ThreadBuffer& getThreadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+
+    if (!buffer) {
+      auto owned = std::make_unique<ThreadBuffer>();
+      owned->chunks.push_back(std::make_unique<Chunk>());
+      owned->head = owned->tail = owned->chunks.back().get();
+
+      std::lock_guard<std::mutex> lock(bufferMutex);
+      owned->id = static_cast<int>(buffers.size()) + 1;
+      owned->name = "thread-" + std::to_string(owned->id);
+      buffer = owned.get();
+      buffers.push_back(std::move(owned));
+    }
+
+    return *buffer;
+  }
+
+  /// @brief Flushes the trace when a long-running script, such as a web
+  /// server, is interrupted.
+  void watchSignals() {
+#ifndef _WIN64
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    if (pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0) {
+      return;
+    }
+
+    std::thread([signals]() {
+      int signal = 0;
+      if (sigwait(&signals, &signal) == 0) {
+        TraceRecorder::getInstance().stop();
+        std::_Exit(128 + signal);
+      }
+    }).detach();
+#endif
+  }
+
+  static std::string escape(const std::string& text) {
+    std::ostringstream ss;
+    for (unsigned char c : text) {
+      if (c == '"' || c == '\\') {
+        ss << '\\' << c;
+      } else if (c < 0x20) {
+        ss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+           << static_cast<int>(c) << std::dec << std::setfill(' ');
+      } else {
+        ss << c;
+      }
+    }
+    return ss.str();
+  }
+
+  static std::string toMicros(int64_t nanos) {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3) << (nanos / 1e3);
+    return ss.str();
+  }
+
+  void writeJson(std::ofstream& output) const {
+    output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+    bool first = true;
+    for (const auto& buffer : buffers) {
+      output << (first ? "" : ",")
+             << "\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                "\"tid\": "
+             << buffer->id << ", \"args\": {\"name\": \""
+             << escape(buffer->name) << "\"}}";
+      first = false;
+
+      for (auto chunk = buffer->head; chunk;
+           chunk = chunk->next.load(std::memory_order_acquire)) {
+        auto size = chunk->size.load(std::memory_order_acquire);
+
+        for (size_t i = 0; i < size; ++i) {
+          const auto& event = chunk->events[i];
+          output << ",\n  {\"name\": \"" << escape(event.name)
+                 << "\", \"cat\": \"" << event.category
+                 << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id
+                 << ", \"ts\": " << toMicros(event.startNanos)
+                 << ", \"dur\": " << toMicros(event.durationNanos) << "}";
+        }
+      }
+    }
+
+    output << "\n]}\n";
+  }
+};
+
+/// @brief Records a span for the duration of a scope.
+///
+/// Spans shorter than the minimum duration are dropped, which keeps the
+/// trace to the calls that matter.
+class TraceSpan {
+ public:
+  TraceSpan(const char* category, const std::string& name,
+            int64_t minimumNanos = 0)
+      : active(TraceRecorder::isEnabled()) {
+    if (active) {
+      begin(category, name, minimumNanos);
+    }
+  }
+
+  TraceSpan(const char* category, const std::string& owner,
+            const std::string& name, int64_t minimumNanos = 0)
+      : active(TraceRecorder::isEnabled()) {
+    if (active) {
+      begin(category, owner + "." + name, minimumNanos);
+    }
+  }
+
+  ~TraceSpan() {
+    if (!active) {
+      return;
+    }
+
+    auto end = TraceRecorder::Clock::now();
+    if (end - start >= std::chrono::nanoseconds(minimumNanos)) {
+      TraceRecorder::getInstance().record(category, name, start, end);
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  bool active;
+  const char* category = nullptr;
+  std::string name;
+  int64_t minimumNanos = 0;
+  TraceRecorder::Clock::time_point start;
+
+  void begin(const char* spanCategory, const std::string& spanName,
+             int64_t spanMinimumNanos) {
+    category = spanCategory;
+    name = spanName;
+    minimumNanos = spanMinimumNanos;
+    start = TraceRecorder::Clock::now();
+  }
+};
+
+#endif
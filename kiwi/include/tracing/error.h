@@ -227,6 +227,14 @@ class EmptyStackError : public KiwiError {
       : KiwiError(token, "EmptyStackError", "The stack is empty.") {}
 };
 
+class StackOverflowError : public KiwiError {
+ public:
+  StackOverflowError(const Token& token, size_t depth)
+      : KiwiError(token, "StackOverflowError",
+                  "The call stack overflowed at a depth of " +
+                      std::to_string(depth) + ".") {}
+};
+
 class IllegalNameError : public KiwiError {
  public:
   IllegalNameError(const Token& token, const std::string& name)
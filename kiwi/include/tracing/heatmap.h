@@ -0,0 +1,284 @@
+#ifndef KIWI_TRACING_HEATMAP_H
+#define KIWI_TRACING_HEATMAP_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parsing/tokens.h"
+#include "system/fileregistry.h"
+#include "tracing/hooks.h"
+
+/// @brief Per-line execution counts and inclusive wall time.
+///
+/// A line is entered when the interpreter visits a node whose line differs
+/// from the innermost line already being timed. Time is charged only to the
+/// outermost active entry of a line, so recursion does not count twice.
+class Heatmap {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static Heatmap& getInstance() {
+    static Heatmap instance;
+    return instance;
+  }
+
+  Heatmap(const Heatmap&) = delete;
+  Heatmap& operator=(const Heatmap&) = delete;
+
+  void start(const std::string& path) {
+    if (enabled) {
+      return;
+    }
+
+    outputPath = path;
+    owner = std::this_thread::get_id();
+    enabled = true;
+    startTime = Clock::now();
+    InterpreterHooks::set(InterpreterHook::LineCounts);
+
+    // The report reads source lines, so the registry must outlive it.
+    FileRegistry::getInstance();
+    std::atexit([]() { Heatmap::getInstance().stop(); });
+  }
+
+  /// @brief Enters the line of a token if it starts a new line.
+  /// @return Boolean indicating whether the caller must call `leave`.
+  bool enter(const Token& token) {
+    if (token.getType() == KTokenType::ENDOFFILE ||
+        std::this_thread::get_id() != owner) {
+      return false;
+    }
+
+    auto file = token.getFile();
+    auto line = token.getLineNumber();
+
+    if (!active.empty() && active.back().file == file &&
+        active.back().line == line) {
+      return false;
+    }
+
+    auto& stats = lines[{file, line}];
+    ++stats.count;
+    active.push_back({file, line, &stats, Clock::now()});
+    ++stats.depth;
+    return true;
+  }
+
+  void leave() {
+    auto entry = active.back();
+    active.pop_back();
+
+    if (--entry.stats->depth == 0) {
+      auto elapsed = Clock::now() - entry.start;
+      entry.stats->nanos +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+              .count();
+    }
+  }
+
+  void stop() {
+    if (!enabled) {
+      return;
+    }
+
+    enabled = false;
+    InterpreterHooks::clear(InterpreterHook::LineCounts);
+    totalNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     Clock::now() - startTime)
+                     .count();
+
+    std::ofstream output(outputPath);
+    if (!output.is_open()) {
+      std::cerr << "Could not write heatmap to " << outputPath << std::endl;
+      return;
+    }
+
+    if (isJsonPath(outputPath)) {
+      writeJson(output);
+    } else {
+      writeListing(output);
+    }
+  }
+
+ private:
+  struct LineStats {
+    long long count = 0;
+    long long nanos = 0;
+    int depth = 0;
+  };
+
+  struct ActiveLine {
+    int file;
+    int line;
+    LineStats* stats;
+    Clock::time_point start;
+  };
+
+  inline static bool enabled = false;
+
+  std::thread::id owner;
+  std::string outputPath;
+  std::map<std::pair<int, int>, LineStats> lines;
+  std::vector<ActiveLine> active;
+  Clock::time_point startTime;
+  long long totalNanos = 0;
+
+  Heatmap() {}
+
+  static bool isJsonPath(const std::string& path) {
+    const std::string extension = ".json";
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(),
+                        extension) == 0;
+  }
+
+  static std::string toMilliseconds(long long nanos) {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3) << (nanos / 1e6);
+    return ss.str();
+  }
+
+  std::string getPercentage(long long nanos) const {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1)
+       << (totalNanos > 0 ? 100.0 * nanos / totalNanos : 0.0) << "%";
+    return ss.str();
+  }
+
+  static std::string escape(const std::string& text) {
+    std::ostringstream ss;
+    for (unsigned char c : text) {
+      switch (c) {
+        case '"':
+          ss << "\\\"";
+          break;
+        case '\\':
+          ss << "\\\\";
+          break;
+        case '\t':
+          ss << "\\t";
+          break;
+        case '\r':
+          ss << "\\r";
+          break;
+        default:
+          if (c < 0x20) {
+            ss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+               << static_cast<int>(c) << std::dec << std::setfill(' ');
+          } else {
+            ss << c;
+          }
+          break;
+      }
+    }
+    return ss.str();
+  }
+
+  void writeJson(std::ofstream& output) const {
+    auto& registry = FileRegistry::getInstance();
+    int currentFile = -1;
+    std::vector<std::string> source;
+
+    output << "{\"total_ms\": " << toMilliseconds(totalNanos)
+           << ", \"lines\": [";
+
+    bool first = true;
+    for (const auto& pair : lines) {
+      auto file = pair.first.first;
+      auto line = pair.first.second;
+      const auto& stats = pair.second;
+
+      if (file != currentFile) {
+        currentFile = file;
+        source = registry.getFileLines(file);
+      }
+
+      output << (first ? "" : ",") << "\n  {\"file\": \""
+             << escape(registry.getFilePath(file)) << "\", \"line\": "
+             << line + 1 << ", \"count\": " << stats.count
+             << ", \"time_ms\": " << toMilliseconds(stats.nanos)
+             << ", \"source\": \""
+             << escape(line < static_cast<int>(source.size()) ? source[line]
+                                                              : "")
+             << "\"}";
+      first = false;
+    }
+
+    output << "\n]}\n";
+  }
+
+  void writeListing(std::ofstream& output) const {
+    auto& registry = FileRegistry::getInstance();
+
+    // List the files that took the most time first.
+    std::map<int, long long> fileNanos;
+    for (const auto& pair : lines) {
+      auto& nanos = fileNanos[pair.first.first];
+      nanos = std::max(nanos, pair.second.nanos);
+    }
+
+    std::vector<std::pair<int, long long>> files(fileNanos.begin(),
+                                                 fileNanos.end());
+    std::stable_sort(files.begin(), files.end(),
+                     [](const auto& a, const auto& b) {
+                       return a.second > b.second;
+                     });
+
+    for (const auto& file : files) {
+      auto source = registry.getFileLines(file.first);
+
+      output << "==> " << registry.getFilePath(file.first) << " <==\n"
+             << std::right << std::setw(10) << "count" << std::setw(12)
+             << "time (ms)" << std::setw(8) << "time" << "  "
+             << "line\n";
+
+      for (int line = 0; line < static_cast<int>(source.size()); ++line) {
+        auto stats = lines.find({file.first, line});
+
+        if (stats == lines.end()) {
+          output << std::setw(30) << "";
+        } else {
+          output << std::setw(10) << stats->second.count << std::setw(12)
+                 << toMilliseconds(stats->second.nanos) << std::setw(8)
+                 << getPercentage(stats->second.nanos);
+        }
+
+        output << "  " << std::setw(5) << line + 1 << "| " << source[line]
+               << "\n";
+      }
+
+      output << "\n";
+    }
+  }
+};
+
+/// @brief Times the line of a node for the duration of a scope.
+class HeatmapScope {
+ public:
+  explicit HeatmapScope(const Token& token)
+      : active(Heatmap::getInstance().enter(token)) {}
+
+  ~HeatmapScope() {
+    if (active) {
+      Heatmap::getInstance().leave();
+    }
+  }
+
+  HeatmapScope(const HeatmapScope&) = delete;
+  HeatmapScope& operator=(const HeatmapScope&) = delete;
+
+ private:
+  bool active;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef KIWI_TRACING_HOOKS_H
+#define KIWI_TRACING_HOOKS_H
+
+#include <atomic>
+#include <cstdint>
+
+/// @brief Reasons for `KInterpreter::interpret` to leave its fast path.
+enum class InterpreterHook : uint32_t {
+  None = 0,
+  Sample = 1 << 0,
+  LineCounts = 1 << 1,
+  MemorySites = 1 << 2,
+  Collect = 1 << 3,
+};
+
+/// @brief A word of pending interpreter hooks.
+///
+/// The interpreter tests the whole word once per node, so tracing features
+/// cost a single branch while they are switched off. Setting a bit is
+/// async-signal-safe.
+class InterpreterHooks {
+ public:
+  static bool any() { return flags.load(std::memory_order_relaxed) != 0; }
+
+  static bool isSet(InterpreterHook hook) {
+    return (flags.load(std::memory_order_relaxed) &
+            static_cast<uint32_t>(hook)) != 0;
+  }
+
+  static void set(InterpreterHook hook) {
+    flags.fetch_or(static_cast<uint32_t>(hook), std::memory_order_relaxed);
+  }
+
+  static void clear(InterpreterHook hook) {
+    flags.fetch_and(~static_cast<uint32_t>(hook), std::memory_order_relaxed);
+  }
+
+ private:
+  inline static std::atomic<uint32_t> flags{0};
+};
+
+#endif
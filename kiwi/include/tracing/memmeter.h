@@ -0,0 +1,162 @@
+#ifndef KIWI_TRACING_MEMMETER_H
+#define KIWI_TRACING_MEMMETER_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "parsing/ast.h"
+#include "stackframe.h"
+#include "tracing/memstats.h"
+#include "typing/value.h"
+
+/// @brief Estimates the bytes held by the values reachable from a set of
+/// roots.
+///
+/// Each container is counted once, however many references reach it.
+/// Strings count only the heap storage beyond their inline buffer.
+class MemoryMeter {
+ public:
+  struct Usage {
+    int64_t count = 0;
+    int64_t bytes = 0;
+  };
+
+  void addFrame(const CallStackFrame& frame) {
+    if (!seen.insert(&frame).second) {
+      return;
+    }
+
+    auto& frameUsage = getUsage(MemoryKind::Frame);
+    ++frameUsage.count;
+    frameUsage.bytes += sizeof(CallStackFrame) + ControlBlockBytes +
+                        getMapBytes(frame.variables);
+
+    for (const auto& pair : frame.variables) {
+      addString(pair.first);
+      addValue(pair.second);
+    }
+
+    addValue(frame.returnValue);
+
+    if (frame.objectContext) {
+      addValue(frame.objectContext);
+    }
+  }
+
+  void addCallable(const KCallable& callable) {
+    for (const auto& param : callable.parameters) {
+      addValue(param.second);
+    }
+  }
+
+  void addValue(const k_value& root) {
+    pending.push_back(root);
+
+    while (!pending.empty()) {
+      auto value = std::move(pending.back());
+      pending.pop_back();
+      visit(value);
+    }
+  }
+
+  Usage& getUsage(MemoryKind kind) { return usage[static_cast<int>(kind)]; }
+
+  Usage& getStringUsage() { return strings; }
+
+ private:
+  static constexpr int64_t ControlBlockBytes = 16;
+
+  std::array<Usage, MemoryStats::KindCount> usage;
+  Usage strings;
+  std::unordered_set<const void*> seen;
+  std::vector<k_value> pending;
+
+  static int64_t getMapBytes(
+      const std::unordered_map<k_string, k_value>& map) {
+    using Node = std::pair<const k_string, k_value>;
+    return map.bucket_count() * sizeof(void*) +
+           map.size() * (sizeof(Node) + sizeof(void*) + sizeof(size_t));
+  }
+
+  void addString(const k_string& text) {
+    static const auto inlineCapacity = k_string().capacity();
+
+    ++strings.count;
+    if (text.capacity() > inlineCapacity) {
+      strings.bytes += text.capacity() + 1;
+    }
+  }
+
+  void visit(const k_value& value) {
+    if (std::holds_alternative<k_string>(value)) {
+      addString(std::get<k_string>(value));
+    } else if (std::holds_alternative<k_list>(value)) {
+      const auto& list = std::get<k_list>(value);
+      if (!list || !seen.insert(list.get()).second) {
+        return;
+      }
+
+      auto& listUsage = getUsage(MemoryKind::List);
+      ++listUsage.count;
+      listUsage.bytes += sizeof(List) + ControlBlockBytes +
+                         list->elements.capacity() * sizeof(k_value);
+
+      for (const auto& element : list->elements) {
+        pending.push_back(element);
+      }
+    } else if (std::holds_alternative<k_hash>(value)) {
+      const auto& hash = std::get<k_hash>(value);
+      if (!hash || !seen.insert(hash.get()).second) {
+        return;
+      }
+
+      auto& hashUsage = getUsage(MemoryKind::Hash);
+      ++hashUsage.count;
+      hashUsage.bytes += sizeof(Hash) + ControlBlockBytes +
+                         getMapBytes(hash->kvp) +
+                         hash->keys.capacity() * sizeof(k_string);
+
+      for (const auto& key : hash->keys) {
+        addString(key);
+      }
+
+      for (const auto& pair : hash->kvp) {
+        addString(pair.first);
+        pending.push_back(pair.second);
+      }
+    } else if (std::holds_alternative<k_object>(value)) {
+      const auto& object = std::get<k_object>(value);
+      if (!object || !seen.insert(object.get()).second) {
+        return;
+      }
+
+      auto& objectUsage = getUsage(MemoryKind::Object);
+      ++objectUsage.count;
+      // Variable names live in the shape, which objects share.
+      objectUsage.bytes += sizeof(Object) + ControlBlockBytes +
+                           object->slots.capacity() * sizeof(k_value);
+
+      addString(object->identifier);
+      addString(object->className);
+
+      for (const auto& slot : object->slots) {
+        pending.push_back(slot);
+      }
+    } else if (std::holds_alternative<k_matrix>(value)) {
+      const auto& matrix = std::get<k_matrix>(value);
+      if (!matrix || !seen.insert(matrix.get()).second) {
+        return;
+      }
+
+      auto& matrixUsage = getUsage(MemoryKind::Matrix);
+      ++matrixUsage.count;
+      matrixUsage.bytes += sizeof(Matrix) + ControlBlockBytes +
+                           matrix->cells.capacity() * sizeof(double);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef KIWI_TRACING_MEMSTATS_H
+#define KIWI_TRACING_MEMSTATS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "tracing/hooks.h"
+
+enum class MemoryKind : int {
+  List,
+  Hash,
+  Object,
+  Matrix,
+  Frame,
+  Count,
+};
+
+struct MemoryCounter {
+  std::atomic<int64_t> live{0};
+  std::atomic<int64_t> peak{0};
+  std::atomic<int64_t> total{0};
+};
+
+/// @brief Live, peak, and total allocation counts by value type.
+///
+/// Each thread counts into its own counters, which only that thread writes,
+/// so counting is a plain load and store rather than an atomic
+/// read-modify-write. Reports add up every thread's counters. A value freed
+/// on another thread than the one that made it lowers that thread's live
+/// count, so the sum stays right, but the peak is then the sum of each
+/// thread's peak, which can overstate the true peak.
+///
+/// In sampling mode, about one allocation in n is attributed to the source
+/// line the interpreter was visiting, weighted by the sampling interval.
+class MemoryStats {
+ public:
+  struct Site {
+    MemoryKind kind;
+    int file;
+    int line;
+    int64_t count;
+  };
+
+  static constexpr int KindCount = static_cast<int>(MemoryKind::Count);
+
+  static const char* getKindName(MemoryKind kind) {
+    switch (kind) {
+      case MemoryKind::List:
+        return "list";
+      case MemoryKind::Hash:
+        return "hash";
+      case MemoryKind::Object:
+        return "object";
+      case MemoryKind::Matrix:
+        return "matrix";
+      case MemoryKind::Frame:
+        return "frame";
+      default:
+        break;
+    }
+
+    return "unknown";
+  }
+
+  static void onAllocate(MemoryKind kind) {
+    auto counters = getThreadCounters();
+    if (!counters) {
+      auto& counter = exited[static_cast<int>(kind)];
+      counter.live.fetch_add(1, std::memory_order_relaxed);
+      counter.total.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    auto& counter = (*counters)[static_cast<int>(kind)];
+    auto live = counter.live.load(std::memory_order_relaxed) + 1;
+    counter.live.store(live, std::memory_order_relaxed);
+    counter.total.store(counter.total.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+    if (live > counter.peak.load(std::memory_order_relaxed)) {
+      counter.peak.store(live, std::memory_order_relaxed);
+    }
+
+    if (sampleInterval > 0) {
+      recordSite(kind);
+    }
+  }
+
+  static void onRelease(MemoryKind kind) {
+    auto counters = getThreadCounters();
+    if (!counters) {
+      exited[static_cast<int>(kind)].live.fetch_sub(1,
+                                                    std::memory_order_relaxed);
+      return;
+    }
+
+    auto& live = (*counters)[static_cast<int>(kind)].live;
+    live.store(live.load(std::memory_order_relaxed) - 1,
+               std::memory_order_relaxed);
+  }
+
+  static int64_t getLive(MemoryKind kind) {
+    return sum(kind, &MemoryCounter::live);
+  }
+
+  /// @brief Gets the peak live count, which is exact when values are made
+  /// and freed on one thread and an upper bound otherwise.
+  static int64_t getPeak(MemoryKind kind) {
+    auto peak = std::min(sum(kind, &MemoryCounter::peak), getTotal(kind));
+    return std::max(peak, getLive(kind));
+  }
+
+  static int64_t getTotal(MemoryKind kind) {
+    return sum(kind, &MemoryCounter::total);
+  }
+
+  static void startSampling(int interval) {
+    sampleInterval = std::max(interval, 1);
+    sampleCountdown = getSampleGap();
+    InterpreterHooks::set(InterpreterHook::MemorySites);
+  }
+
+  static int getSampleInterval() { return sampleInterval; }
+
+  static void setSite(int file, int line) {
+    siteFile = file;
+    siteLine = line;
+  }
+
+  /// @brief Gets the sampled allocation sites, heaviest first.
+  static std::vector<Site> getSites() {
+    std::vector<Site> result;
+
+    {
+      std::lock_guard<std::mutex> lock(siteMutex);
+      for (const auto& pair : sites) {
+        result.push_back({std::get<0>(pair.first), std::get<1>(pair.first),
+                          std::get<2>(pair.first), pair.second});
+      }
+    }
+
+    std::stable_sort(result.begin(), result.end(),
+                     [](const Site& a, const Site& b) {
+                       return a.count > b.count;
+                     });
+    return result;
+  }
+
+ private:
+  using Counters = std::array<MemoryCounter, KindCount>;
+
+  /// @brief A thread's counters, registered for reports while the thread
+  /// runs and folded into the exited counts when it ends.
+  struct ThreadCounters {
+    Counters counters;
+
+    ThreadCounters() {
+      std::lock_guard<std::mutex> lock(threadMutex);
+      threads.push_back(&counters);
+    }
+
+    ~ThreadCounters() {
+      std::lock_guard<std::mutex> lock(threadMutex);
+      for (int i = 0; i < KindCount; ++i) {
+        exited[i].live += counters[i].live.load();
+        exited[i].peak += counters[i].peak.load();
+        exited[i].total += counters[i].total.load();
+      }
+      threads.erase(std::find(threads.begin(), threads.end(), &counters));
+      threadExited = true;
+    }
+  };
+
+  inline static Counters exited;
+  inline static std::mutex threadMutex;
+  inline static std::vector<Counters*> threads;
+  inline static thread_local bool threadExited = false;
+  inline static int sampleInterval = 0;
+  inline static std::atomic<int64_t> sampleCountdown{0};
+  inline static uint64_t sampleSeed = 0x9e3779b97f4a7c15ULL;
+  inline static int siteFile = -1;
+  inline static int siteLine = -1;
+  inline static std::mutex siteMutex;
+  inline static std::map<std::tuple<MemoryKind, int, int>, int64_t> sites;
+
+  /// @brief Gets the calling thread's counters, or null once the thread's
+  /// counters are gone, as when values are freed during thread exit.
+  static Counters* getThreadCounters() {
+    if (threadExited) {
+      return nullptr;
+    }
+
+    thread_local ThreadCounters counters;
+    return &counters.counters;
+  }
+
+  static int64_t sum(MemoryKind kind,
+                     std::atomic<int64_t> MemoryCounter::*field) {
+    auto index = static_cast<int>(kind);
+    std::lock_guard<std::mutex> lock(threadMutex);
+    auto total = (exited[index].*field).load();
+    for (const auto* counters : threads) {
+      total += ((*counters)[index].*field).load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /// @brief Gets a random gap averaging the sampling interval, so that
+  /// allocation patterns in loops do not alias with a fixed stride.
+  static int64_t getSampleGap() {
+    sampleSeed ^= sampleSeed << 13;
+    sampleSeed ^= sampleSeed >> 7;
+    sampleSeed ^= sampleSeed << 17;
+    return 1 + static_cast<int64_t>(sampleSeed % (2 * sampleInterval - 1));
+  }
+
+  static void recordSite(MemoryKind kind) {
+    if (sampleCountdown.fetch_sub(1, std::memory_order_relaxed) > 1) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(siteMutex);
+    sampleCountdown = getSampleGap();
+    sites[{kind, siteFile, siteLine}] += sampleInterval;
+  }
+};
+
+/// @brief A base that counts the instances of a value type.
+template <MemoryKind Kind>
+struct MemoryTracked {
+  MemoryTracked() { MemoryStats::onAllocate(Kind); }
+  MemoryTracked(const MemoryTracked&) { MemoryStats::onAllocate(Kind); }
+  MemoryTracked& operator=(const MemoryTracked&) { return *this; }
+  ~MemoryTracked() { MemoryStats::onRelease(Kind); }
+};
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef KIWI_TRACING_PROFILER_H
+#define KIWI_TRACING_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifndef _WIN64
+#include <sys/time.h>
+#endif
+
+#include "parsing/tokens.h"
+#include "system/fileregistry.h"
+#include "tracing/hooks.h"
+
+/// @brief A sampling profiler for Kiwi code.
+///
+/// A CPU timer raises `SIGPROF`, and the handler only flags a pending sample.
+/// The interpreter records the sample at the next node it visits, using a
+/// shadow stack of callable names and call sites, so the signal handler
+/// never touches interpreter state.
+class Profiler {
+ public:
+  static Profiler& getInstance() {
+    static Profiler instance;
+    return instance;
+  }
+
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  static bool isEnabled() { return enabled; }
+
+  bool start(const std::string& path) {
+#ifdef _WIN64
+    std::cerr << "The profiler is not supported on this platform."
+              << std::endl;
+    return false;
+#else
+    if (enabled) {
+      return true;
+    }
+
+    outputPath = path;
+    owner = std::this_thread::get_id();
+
+    struct sigaction action = {};
+    action.sa_handler = &Profiler::onTimer;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGPROF, &action, nullptr) != 0) {
+      return false;
+    }
+
+    struct itimerval timer = {};
+    timer.it_interval.tv_usec = SampleIntervalMicros;
+    timer.it_value.tv_usec = SampleIntervalMicros;
+
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+      return false;
+    }
+
+    enabled = true;
+    std::atexit([]() { Profiler::getInstance().stop(); });
+    return true;
+#endif
+  }
+
+  void enter(const Token& token, const std::string& name) {
+    if (std::this_thread::get_id() == owner) {
+      frames.push_back({name, token.getFile(), token.getLineNumber()});
+    }
+  }
+
+  void leave() {
+    if (std::this_thread::get_id() == owner && !frames.empty()) {
+      frames.pop_back();
+    }
+  }
+
+  void sample(const Token& token) {
+    // Nodes without a source token leave the sample to the next node.
+    if (token.getType() == KTokenType::ENDOFFILE) {
+      return;
+    }
+
+    InterpreterHooks::clear(InterpreterHook::Sample);
+    auto ticks = pendingTicks.exchange(0);
+
+    if (ticks == 0 || std::this_thread::get_id() != owner) {
+      return;
+    }
+
+    std::string stack;
+    std::unordered_set<std::string> seen;
+
+    for (size_t i = 0; i <= frames.size(); ++i) {
+      const auto& name = i == 0 ? MainFrame : frames[i - 1].name;
+      auto location = i < frames.size()
+                          ? getLocation(frames[i].file, frames[i].line)
+                          : getLocation(token.getFile(), token.getLineNumber());
+
+      if (i > 0) {
+        stack += ';';
+      }
+      stack += name + " (" + location + ")";
+
+      if (seen.insert(name).second) {
+        totalSamples[name] += ticks;
+      }
+
+      if (i == frames.size()) {
+        selfSamples[name] += ticks;
+        lineSamples[location] += ticks;
+      }
+    }
+
+    stacks[stack] += ticks;
+    sampleCount += ticks;
+  }
+
+  void stop() {
+#ifndef _WIN64
+    if (!enabled) {
+      return;
+    }
+
+    enabled = false;
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+
+    writeCollapsedStacks();
+    printSummary();
+#endif
+  }
+
+ private:
+  struct Frame {
+    std::string name;
+    int file;
+    int line;
+  };
+
+  static constexpr int SampleIntervalMicros = 1000;
+  static constexpr size_t SummarySize = 10;
+  inline static const std::string MainFrame = "<main>";
+  inline static bool enabled = false;
+  inline static std::atomic<uint32_t> pendingTicks{0};
+
+  std::thread::id owner;
+  std::string outputPath;
+  std::vector<Frame> frames;
+  std::unordered_map<int, std::string> fileNames;
+  std::unordered_map<std::string, size_t> stacks;
+  std::unordered_map<std::string, size_t> selfSamples;
+  std::unordered_map<std::string, size_t> totalSamples;
+  std::unordered_map<std::string, size_t> lineSamples;
+  size_t sampleCount = 0;
+
+  Profiler() {}
+
+  static void onTimer(int) {
+    pendingTicks.fetch_add(1, std::memory_order_relaxed);
+    InterpreterHooks::set(InterpreterHook::Sample);
+  }
+
+  std::string getLocation(int file, int line) {
+    auto it = fileNames.find(file);
+    if (it == fileNames.end()) {
+      auto path = FileRegistry::getInstance().getFilePath(file);
+      auto fileName = std::filesystem::path(path).filename().string();
+      it = fileNames.emplace(file, fileName).first;
+    }
+
+    return it->second + ":" + std::to_string(line + 1);
+  }
+
+  void writeCollapsedStacks() const {
+    std::ofstream output(outputPath);
+    if (!output.is_open()) {
+      std::cerr << "Could not write profile to " << outputPath << std::endl;
+      return;
+    }
+
+    for (const auto& pair : stacks) {
+      output << pair.first << " " << pair.second << "\n";
+    }
+  }
+
+  static std::vector<std::pair<std::string, size_t>> getTop(
+      const std::unordered_map<std::string, size_t>& counts) {
+    std::vector<std::pair<std::string, size_t>> top(counts.begin(),
+                                                    counts.end());
+    std::sort(top.begin(), top.end(), [](const auto& a, const auto& b) {
+      return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+
+    if (top.size() > SummarySize) {
+      top.resize(SummarySize);
+    }
+
+    return top;
+  }
+
+  std::string getPercentage(size_t count) const {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1)
+       << (100.0 * count / std::max<size_t>(sampleCount, 1)) << "%";
+    return ss.str();
+  }
+
+  void printSummary() const {
+    std::cerr << std::endl
+              << "Profile: " << sampleCount << " samples at "
+              << SampleIntervalMicros << "us, collapsed stacks written to "
+              << outputPath << std::endl;
+
+    if (sampleCount == 0) {
+      return;
+    }
+
+    std::cerr << std::endl
+              << "  " << std::left << std::setw(9) << "Self" << std::setw(9)
+              << "Total" << "Function" << std::endl;
+
+    for (const auto& pair : getTop(selfSamples)) {
+      std::cerr << "  " << std::left << std::setw(9)
+                << getPercentage(pair.second) << std::setw(9)
+                << getPercentage(totalSamples.at(pair.first)) << pair.first
+                << std::endl;
+    }
+
+    std::cerr << std::endl
+              << "  " << std::left << std::setw(9) << "Self" << "Line"
+              << std::endl;
+
+    for (const auto& pair : getTop(lineSamples)) {
+      std::cerr << "  " << std::left << std::setw(9)
+                << getPercentage(pair.second) << pair.first << std::endl;
+    }
+
+    std::cerr << std::endl;
+  }
+};
+
+/// @brief Pushes a callable onto the profiler's shadow stack for a scope.
+class ProfilerScope {
+ public:
+  ProfilerScope(const Token& token, const std::string& name)
+      : active(Profiler::isEnabled()) {
+    if (active) {
+      Profiler::getInstance().enter(token, name);
+    }
+  }
+
+  ProfilerScope(const Token& token, const std::string& owner,
+                const std::string& name)
+      : active(Profiler::isEnabled()) {
+    if (active) {
+      Profiler::getInstance().enter(token, owner + "." + name);
+    }
+  }
+
+  ~ProfilerScope() {
+    if (active) {
+      Profiler::getInstance().leave();
+    }
+  }
+
+  ProfilerScope(const ProfilerScope&) = delete;
+  ProfilerScope& operator=(const ProfilerScope&) = delete;
+
+ private:
+  bool active;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef KIWI_TRACING_RUNTIMESTATS_H
+#define KIWI_TRACING_RUNTIMESTATS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+enum class RuntimeCounter : int {
+  Nodes,
+  ParsedNodes,
+  FunctionCalls,
+  MethodCalls,
+  LambdaCalls,
+  TailCalls,
+  Frames,
+  Imports,
+  RegexCompiles,
+  Serializations,
+  SerializeNanos,
+  Collections,
+  CollectedValues,
+  CollectNanos,
+  Count,
+};
+
+/// @brief Counters for interpreter internals, always on.
+///
+/// Each thread counts into its own counters, which only that thread writes,
+/// so a counter costs an ordinary increment and threads do not share a
+/// cache line. Reading a counter adds up every thread's count.
+class RuntimeStats {
+ public:
+  static constexpr int CounterCount = static_cast<int>(RuntimeCounter::Count);
+
+  static void increment(RuntimeCounter counter) { add(counter, 1); }
+
+  static void add(RuntimeCounter counter, int64_t amount) {
+    auto counters = getThreadCounters();
+    if (!counters) {
+      exited[static_cast<int>(counter)].fetch_add(amount,
+                                                  std::memory_order_relaxed);
+      return;
+    }
+
+    auto& value = (*counters)[static_cast<int>(counter)];
+    value.store(value.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+  }
+
+  static int64_t get(RuntimeCounter counter) {
+    auto index = static_cast<int>(counter);
+    std::lock_guard<std::mutex> lock(threadMutex);
+    auto total = exited[index].load(std::memory_order_relaxed);
+    for (const auto* counters : threads) {
+      total += (*counters)[index].load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /// @brief Records the call stack depth after a frame is pushed.
+  static void onFramePushed(size_t depth) {
+    auto value = static_cast<int64_t>(depth);
+    if (value > maxDepth.load(std::memory_order_relaxed)) {
+      maxDepth.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  static int64_t getMaxDepth() {
+    return maxDepth.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Records a cycle collection and its pause time.
+  static void onCollection(int64_t pauseNanos, int64_t freed) {
+    increment(RuntimeCounter::Collections);
+    add(RuntimeCounter::CollectedValues, freed);
+    add(RuntimeCounter::CollectNanos, pauseNanos);
+
+    if (pauseNanos > maxCollectNanos.load(std::memory_order_relaxed)) {
+      maxCollectNanos.store(pauseNanos, std::memory_order_relaxed);
+    }
+  }
+
+  static int64_t getMaxCollectNanos() {
+    return maxCollectNanos.load(std::memory_order_relaxed);
+  }
+
+  static int64_t getUptimeNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - startTime)
+        .count();
+  }
+
+ private:
+  using Counters = std::array<std::atomic<int64_t>, CounterCount>;
+
+  /// @brief A thread's counters, registered for reads while the thread runs
+  /// and folded into the exited counts when it ends.
+  struct ThreadCounters {
+    Counters counters{};
+
+    ThreadCounters() {
+      std::lock_guard<std::mutex> lock(threadMutex);
+      threads.push_back(&counters);
+    }
+
+    ~ThreadCounters() {
+      std::lock_guard<std::mutex> lock(threadMutex);
+      for (int i = 0; i < CounterCount; ++i) {
+        exited[i] += counters[i].load();
+      }
+      threads.erase(std::find(threads.begin(), threads.end(), &counters));
+      threadExited = true;
+    }
+  };
+
+  inline static Counters exited{};
+  inline static std::mutex threadMutex;
+  inline static std::vector<Counters*> threads;
+  inline static thread_local bool threadExited = false;
+  inline static std::atomic<int64_t> maxDepth{0};
+  inline static std::atomic<int64_t> maxCollectNanos{0};
+  inline static const std::chrono::steady_clock::time_point startTime =
+      std::chrono::steady_clock::now();
+
+  /// @brief Gets the calling thread's counters, or null once the thread's
+  /// counters are gone during thread exit.
+  static Counters* getThreadCounters() {
+    if (threadExited) {
+      return nullptr;
+    }
+
+    thread_local ThreadCounters counters;
+    return &counters.counters;
+  }
+};
+
+/// @brief Charges the wall time of the outermost serialization on a thread.
+class SerializationTimer {
+ public:
+  SerializationTimer() : outermost(depth++ == 0) {
+    if (outermost) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~SerializationTimer() {
+    --depth;
+
+    if (outermost) {
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      RuntimeStats::increment(RuntimeCounter::Serializations);
+      RuntimeStats::add(
+          RuntimeCounter::SerializeNanos,
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+              .count());
+    }
+  }
+
+  SerializationTimer(const SerializationTimer&) = delete;
+  SerializationTimer& operator=(const SerializationTimer&) = delete;
+
+ private:
+  inline static thread_local int depth = 0;
+  bool outermost;
+  std::chrono::steady_clock::time_point start;
+};
+
+#endif
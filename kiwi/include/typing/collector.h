@@ -0,0 +1,355 @@
+#ifndef KIWI_TYPING_COLLECTOR_H
+#define KIWI_TYPING_COLLECTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "tracing/hooks.h"
+#include "tracing/runtimestats.h"
+
+class CycleNode;
+struct CycleRegistry;
+
+using CycleVisitor = std::function<void(CycleNode*)>;
+
+/// @brief A base for values that can refer to other values, so that the
+/// cycle collector can find and break reference cycles among them.
+///
+/// Nodes register themselves with their thread's registry on construction
+/// and unregister on destruction. The weak reference kept by `enable_shared_from_this` lets the collector
+/// read a node's reference count.
+class CycleNode : public std::enable_shared_from_this<CycleNode> {
+ public:
+  CycleNode();
+  CycleNode(const CycleNode&) : CycleNode() {}
+  CycleNode& operator=(const CycleNode&) { return *this; }
+  virtual ~CycleNode();
+
+  /// @brief Calls the visitor with each node this one refers to.
+  virtual void visitReferences(const CycleVisitor& visit) const = 0;
+
+  /// @brief Drops the references held by this node.
+  virtual void clearReferences() = 0;
+
+ private:
+  friend class CycleCollector;
+
+  CycleRegistry* registry = nullptr;
+  size_t index = 0;
+  int generation = 0;
+  int64_t gcRefs = 0;
+  uint64_t epoch = 0;
+  bool isLeaf = false;
+};
+
+/// @brief The nodes registered by one thread at a time, by generation.
+struct CycleRegistry {
+  std::mutex mutex;
+  std::vector<CycleNode*> generations[2];
+  int64_t allocations = 0;
+};
+
+/// @brief A backup collector for reference cycles among lists, hashes, and
+/// objects, using trial deletion.
+///
+/// Values are reference counted, so the collector only has to find cycles
+/// that nothing outside the tracked values refers to. For each tracked
+/// value it subtracts the references held by other tracked values from its
+/// reference count. Values left with a positive count are referenced from
+/// elsewhere, such as a call frame or a local in the interpreter, and so is
+/// everything they reach. The rest are garbage; their references are
+/// dropped, which frees them.
+///
+/// Values start in the young generation and move to the old one when they
+/// survive a collection. Most collections only examine young values,
+/// treating references from old values as outside references; the whole
+/// heap is examined once the old generation has doubled.
+///
+/// Collections run at interpreter safe points. Values built outside the
+/// interpreter lock, such as web server requests, are left untracked and
+/// count as outside references.
+///
+/// Each thread registers its nodes in a registry of its own, so allocating
+/// and freeing only take that registry's lock, which is uncontended unless
+/// a node is freed on another thread or a collection is running. A thread's
+/// registry is handed to a later thread when it exits, and registries are
+/// never freed, so a node can always reach its registry.
+class CycleCollector {
+ public:
+  struct Result {
+    int64_t tracked;
+    int64_t freed;
+    int64_t pauseNanos;
+  };
+
+  /// @brief Leaves the values created on this thread untracked while in
+  /// scope.
+  class UntrackedScope {
+   public:
+    UntrackedScope() { ++untrackedDepth; }
+    ~UntrackedScope() { --untrackedDepth; }
+
+    UntrackedScope(const UntrackedScope&) = delete;
+    UntrackedScope& operator=(const UntrackedScope&) = delete;
+  };
+
+  /// @brief Sets the number of allocations between automatic collections.
+  /// Zero turns automatic collection off.
+  static void setThreshold(int64_t allocations) {
+    threshold.store(allocations, std::memory_order_relaxed);
+  }
+
+  static int64_t getTracked() {
+    int64_t tracked = 0;
+    for (auto registry : getRegistries()) {
+      std::lock_guard<std::mutex> lock(registry->mutex);
+      tracked += static_cast<int64_t>(registry->generations[Young].size() +
+                                      registry->generations[Old].size());
+    }
+    return tracked;
+  }
+
+  /// @brief Collects the young generation, or the whole heap when it is due.
+  static Result collectDue() {
+    bool full = false;
+    {
+      std::lock_guard<std::mutex> lock(collectMutex);
+      full = promoted >=
+             std::max(threshold.load(std::memory_order_relaxed), oldAfterFull);
+    }
+    return collect(full);
+  }
+
+  static Result collect(bool full = true);
+
+ private:
+  friend class CycleNode;
+
+  static constexpr int Young = 0;
+  static constexpr int Old = 1;
+
+  /// @brief Lends a registry to a thread for as long as the thread runs.
+  struct ThreadRegistry {
+    CycleRegistry* registry;
+
+    ThreadRegistry() {
+      std::lock_guard<std::mutex> lock(registriesMutex);
+      if (idleRegistries.empty()) {
+        registry = new CycleRegistry();
+        registries.push_back(registry);
+      } else {
+        registry = idleRegistries.back();
+        idleRegistries.pop_back();
+      }
+    }
+
+    ~ThreadRegistry() {
+      std::lock_guard<std::mutex> lock(registriesMutex);
+      idleRegistries.push_back(registry);
+      threadExited = true;
+    }
+  };
+
+  inline static std::mutex collectMutex;
+  inline static std::mutex registriesMutex;
+  inline static std::vector<CycleRegistry*> registries;
+  inline static std::vector<CycleRegistry*> idleRegistries;
+  inline static thread_local bool threadExited = false;
+  inline static thread_local int untrackedDepth = 0;
+  inline static std::atomic<int64_t> threshold{10000};
+  inline static int64_t promoted = 0;
+  inline static int64_t oldAfterFull = 0;
+  inline static uint64_t currentEpoch = 0;
+
+  /// @brief Gets the calling thread's registry, or null once the thread is
+  /// exiting and has given its registry back.
+  static CycleRegistry* getThreadRegistry() {
+    if (threadExited) {
+      return nullptr;
+    }
+
+    thread_local ThreadRegistry threadRegistry;
+    return threadRegistry.registry;
+  }
+
+  static std::vector<CycleRegistry*> getRegistries() {
+    std::lock_guard<std::mutex> lock(registriesMutex);
+    return registries;
+  }
+
+  static void track(CycleNode* node) {
+    if (untrackedDepth > 0) {
+      return;
+    }
+
+    auto registry = getThreadRegistry();
+    if (!registry) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    auto& young = registry->generations[Young];
+    node->registry = registry;
+    node->generation = Young;
+    node->index = young.size();
+    young.push_back(node);
+
+    auto limit = threshold.load(std::memory_order_relaxed);
+    if (limit > 0 && ++registry->allocations >= limit) {
+      registry->allocations = 0;
+      InterpreterHooks::set(InterpreterHook::Collect);
+    }
+  }
+
+  static void untrack(CycleNode* node) {
+    auto registry = node->registry;
+    if (!registry) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    auto& generation = registry->generations[node->generation];
+    auto last = generation.back();
+    generation[node->index] = last;
+    last->index = node->index;
+    generation.pop_back();
+    node->registry = nullptr;
+  }
+
+  /// @brief Holds a reference to each live node of a generation, which
+  /// keeps it alive while it is examined, and records its reference count.
+  /// Nodes that are already being destroyed are skipped.
+  static void lockGeneration(const std::vector<CycleNode*>& generation,
+                             uint64_t epoch,
+                             std::vector<std::shared_ptr<CycleNode>>& nodes) {
+    for (auto node : generation) {
+      if (auto shared = node->weak_from_this().lock()) {
+        node->epoch = epoch;
+        node->gcRefs = shared.use_count() - 1;
+        nodes.push_back(std::move(shared));
+      }
+    }
+  }
+
+  /// @brief Moves a registry's young generation into its old one.
+  static void promote(CycleRegistry& registry) {
+    auto& young = registry.generations[Young];
+    auto& old = registry.generations[Old];
+
+    for (auto node : young) {
+      node->generation = Old;
+      node->index = old.size();
+      old.push_back(node);
+    }
+
+    promoted += static_cast<int64_t>(young.size());
+    young.clear();
+  }
+};
+
+inline CycleNode::CycleNode() { CycleCollector::track(this); }
+
+inline CycleNode::~CycleNode() { CycleCollector::untrack(this); }
+
+inline CycleCollector::Result CycleCollector::collect(bool full) {
+  std::lock_guard<std::mutex> collectLock(collectMutex);
+  auto start = std::chrono::steady_clock::now();
+  InterpreterHooks::clear(InterpreterHook::Collect);
+
+  auto epoch = ++currentEpoch;
+  auto threadRegistries = getRegistries();
+  std::vector<std::shared_ptr<CycleNode>> nodes;
+  for (auto registry : threadRegistries) {
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    lockGeneration(registry->generations[Young], epoch, nodes);
+    if (full) {
+      lockGeneration(registry->generations[Old], epoch, nodes);
+    }
+    registry->allocations = 0;
+  }
+
+  // Subtract the references held by examined nodes. Nodes that refer to no
+  // examined node are remembered, so marking does not visit them again.
+  bool hasReferences = false;
+  CycleVisitor subtract = [epoch, &hasReferences](CycleNode* child) {
+    if (child->epoch == epoch) {
+      --child->gcRefs;
+      hasReferences = true;
+    }
+  };
+
+  for (const auto& node : nodes) {
+    hasReferences = false;
+    node->visitReferences(subtract);
+    node->isLeaf = !hasReferences;
+  }
+
+  // Mark everything reachable from a node with outside references.
+  const int64_t reachable = -1;
+  std::vector<CycleNode*> pending;
+  CycleVisitor mark = [&pending, epoch, reachable](CycleNode* child) {
+    if (child->epoch == epoch && child->gcRefs != reachable) {
+      child->gcRefs = reachable;
+      if (!child->isLeaf) {
+        pending.push_back(child);
+      }
+    }
+  };
+
+  for (const auto& node : nodes) {
+    if (node->gcRefs > 0) {
+      node->gcRefs = reachable;
+      if (!node->isLeaf) {
+        pending.push_back(node.get());
+      }
+    }
+  }
+
+  while (!pending.empty()) {
+    auto node = pending.back();
+    pending.pop_back();
+    node->visitReferences(mark);
+  }
+
+  std::vector<std::shared_ptr<CycleNode>> garbage;
+  for (auto& node : nodes) {
+    if (node->gcRefs != reachable) {
+      garbage.push_back(std::move(node));
+    }
+  }
+
+  auto freed = static_cast<int64_t>(garbage.size());
+  nodes.clear();
+
+  int64_t old = 0;
+  for (auto registry : threadRegistries) {
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    promote(*registry);
+    old += static_cast<int64_t>(registry->generations[Old].size());
+  }
+
+  if (full) {
+    promoted = 0;
+    oldAfterFull = old - freed;
+  }
+
+  for (const auto& node : garbage) {
+    node->clearReferences();
+  }
+  garbage.clear();
+
+  auto pauseNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  RuntimeStats::onCollection(pauseNanos, freed);
+
+  return {getTracked(), freed, pauseNanos};
+}
+
+#endif
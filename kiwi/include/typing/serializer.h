@@ -9,11 +9,13 @@
 #include <variant>
 #include <vector>
 #include "parsing/keywords.h"
+#include "tracing/runtimestats.h"
 #include "value.h"
 
 struct Serializer {
   static k_string get_value_type_string(k_value v) {
-    if (std::holds_alternative<k_int>(v)) {
+    if (std::holds_alternative<k_int>(v) ||
+        std::holds_alternative<k_bigint>(v)) {
       return TypeNames.Integer;
     } else if (std::holds_alternative<double>(v)) {
       return TypeNames.Double;
@@ -31,6 +33,8 @@ struct Serializer {
       return std::get<k_object>(v)->className;
     } else if (std::holds_alternative<k_lambda>(v)) {
       return TypeNames.With;
+    } else if (std::holds_alternative<k_matrix>(v)) {
+      return TypeNames.Matrix;
     }
 
     return "";
@@ -47,6 +51,7 @@ struct Serializer {
   }
 
   static k_string serialize(k_value v, bool wrapStrings = false) {
+    SerializationTimer timer;
     std::ostringstream sv;
 
     if (std::holds_alternative<k_int>(v)) {
@@ -71,11 +76,35 @@ struct Serializer {
       sv << basic_serialize_object(std::get<k_object>(v));
     } else if (std::holds_alternative<k_lambda>(v)) {
       sv << basic_serialize_lambda(std::get<k_lambda>(v));
+    } else if (std::holds_alternative<k_matrix>(v)) {
+      sv << serialize_matrix(std::get<k_matrix>(v));
+    } else if (std::holds_alternative<k_bigint>(v)) {
+      sv << std::get<k_bigint>(v)->toString();
     }
 
     return sv.str();
   }
 
+  /// @brief Writes a matrix as a list of its rows.
+  static k_string serialize_matrix(const k_matrix& matrix) {
+    std::ostringstream sv;
+    sv << "[";
+
+    for (size_t row = 0; row < matrix->rows; ++row) {
+      sv << (row > 0 ? ", [" : "[");
+      for (size_t col = 0; col < matrix->cols; ++col) {
+        if (col > 0) {
+          sv << ", ";
+        }
+        sv << matrix->at(row, col);
+      }
+      sv << "]";
+    }
+
+    sv << "]";
+    return sv.str();
+  }
+
   static k_string serialize_list(const k_list& list) {
     std::ostringstream sv;
     sv << "[";
@@ -97,6 +126,7 @@ struct Serializer {
   }
 
   static k_string pretty_serialize(k_value v, int indent = 0) {
+    SerializationTimer timer;
     std::ostringstream sv;
 
     if (std::holds_alternative<k_int>(v)) {
@@ -117,6 +147,10 @@ struct Serializer {
       sv << basic_serialize_object(std::get<k_object>(v));
     } else if (std::holds_alternative<k_lambda>(v)) {
       sv << basic_serialize_lambda(std::get<k_lambda>(v));
+    } else if (std::holds_alternative<k_matrix>(v)) {
+      sv << serialize_matrix(std::get<k_matrix>(v));
+    } else if (std::holds_alternative<k_bigint>(v)) {
+      sv << std::get<k_bigint>(v)->toString();
     }
 
     return sv.str();
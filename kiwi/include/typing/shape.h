@@ -0,0 +1,103 @@
+#ifndef KIWI_TYPING_SHAPE_H
+#define KIWI_TYPING_SHAPE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Shape;
+
+/// @brief The position of an instance variable in the objects of a shape.
+struct ShapeSlot {
+  const Shape* shape;
+  int index;
+};
+
+/// @brief Describes the instance variables of an object and their order.
+///
+/// Shapes form a tree rooted at the empty shape. Adding a variable to an
+/// object moves it to the child shape for that name, so objects that gain
+/// the same variables in the same order share a shape. Shapes are never
+/// freed, which lets slots be cached by pointer.
+class Shape {
+ public:
+  static Shape* getRoot() {
+    static Shape root;
+    return &root;
+  }
+
+  Shape(const Shape&) = delete;
+  Shape& operator=(const Shape&) = delete;
+
+  const std::vector<std::string>& getNames() const { return names; }
+
+  size_t size() const { return names.size(); }
+
+  const ShapeSlot* findSlot(const std::string& name) const {
+    auto it = slots.find(name);
+    return it == slots.end() ? nullptr : it->second.get();
+  }
+
+  /// @brief Gets the shape that follows this one when a variable is added.
+  Shape* addVariable(const std::string& name) {
+    std::lock_guard<std::mutex> lock(transitionMutex);
+
+    auto& next = transitions[name];
+    if (!next) {
+      next.reset(new Shape(*this, name));
+    }
+
+    return next.get();
+  }
+
+ private:
+  std::vector<std::string> names;
+  std::unordered_map<std::string, std::unique_ptr<ShapeSlot>> slots;
+  std::unordered_map<std::string, std::unique_ptr<Shape>> transitions;
+  std::mutex transitionMutex;
+
+  Shape() {}
+
+  Shape(const Shape& parent, const std::string& name) : names(parent.names) {
+    names.push_back(name);
+
+    for (size_t i = 0; i < names.size(); ++i) {
+      slots[names[i]].reset(new ShapeSlot{this, static_cast<int>(i)});
+    }
+  }
+};
+
+/// @brief Remembers the slot found by an instance variable access.
+///
+/// Objects built by the same constructor share a shape, so most sites see
+/// one shape and skip the name lookup. The cache holds a single pointer, so
+/// a racing update cannot pair one shape with another shape's slot.
+class SlotCache {
+ public:
+  SlotCache() {}
+  SlotCache(const SlotCache&) {}
+  SlotCache& operator=(const SlotCache&) { return *this; }
+
+  int find(const Shape* shape, const std::string& name) const {
+    auto slot = cached.load(std::memory_order_acquire);
+    if (slot && slot->shape == shape) {
+      return slot->index;
+    }
+
+    slot = shape->findSlot(name);
+    if (!slot) {
+      return -1;
+    }
+
+    cached.store(slot, std::memory_order_release);
+    return slot->index;
+  }
+
+ private:
+  mutable std::atomic<const ShapeSlot*> cached{nullptr};
+};
+
+#endif
@@ -8,7 +8,11 @@
 #include <unordered_map>
 #include <variant>
 #include <vector>
+#include "math/bigint.h"
 #include "tracing/error.h"
+#include "tracing/memstats.h"
+#include "typing/collector.h"
+#include "typing/shape.h"
 
 struct Hash;
 struct List;
@@ -16,6 +20,7 @@ struct Object;
 struct LambdaRef;
 struct ClassRef;
 struct Null;
+struct Matrix;
 
 typedef long long k_int;
 typedef std::string k_string;
@@ -26,14 +31,18 @@ using k_object = std::shared_ptr<Object>;
 using k_lambda = std::shared_ptr<LambdaRef>;
 using k_class = std::shared_ptr<ClassRef>;
 using k_null = std::shared_ptr<Null>;
+using k_matrix = std::shared_ptr<Matrix>;
+using k_bigint = std::shared_ptr<BigInt>;
 
 inline void hash_combine(std::size_t& seed, std::size_t hash);
 std::size_t hash_hash(const k_hash& hash);
 std::size_t hash_list(const k_list& list);
 std::size_t hash_object(const k_object& object);
+std::size_t hash_matrix(const k_matrix& matrix);
 
 using k_value = std::variant<k_int, double, bool, k_string, k_list, k_hash,
-                             k_object, k_lambda, k_null, k_class>;
+                             k_object, k_lambda, k_null, k_class, k_matrix,
+                             k_bigint>;
 
 // Specialize a struct for hash computation for k_value
 namespace std {
@@ -59,6 +68,10 @@ struct hash<k_value> {
       case 8:  // k_null
       case 9:  // k_class
         return false;
+      case 10:  // k_matrix
+        return hash_matrix(std::get<k_matrix>(v));
+      case 11:  // k_bigint
+        return std::get<k_bigint>(v)->hash();
       default:
         // Fallback for unknown types
         return 0;
@@ -69,14 +82,24 @@ struct hash<k_value> {
 
 struct Null {};
 
-struct List {
+inline void visit_references(const k_value& value, const CycleVisitor& visit);
+
+struct List : MemoryTracked<MemoryKind::List>, CycleNode {
   std::vector<k_value> elements;
 
   List() {}
   List(const std::vector<k_value>& values) : elements(values) {}
+
+  void visitReferences(const CycleVisitor& visit) const override {
+    for (const auto& element : elements) {
+      visit_references(element, visit);
+    }
+  }
+
+  void clearReferences() override { elements.clear(); }
 };
 
-struct Hash {
+struct Hash : MemoryTracked<MemoryKind::Hash>, CycleNode {
   std::unordered_map<k_string, k_value> kvp;
   std::vector<k_string> keys;
 
@@ -104,16 +127,103 @@ struct Hash {
       add(key, other->kvp[key]);
     }
   }
+
+  void visitReferences(const CycleVisitor& visit) const override {
+    for (const auto& pair : kvp) {
+      visit_references(pair.second, visit);
+    }
+  }
+
+  void clearReferences() override {
+    kvp.clear();
+    keys.clear();
+  }
 };
 
-struct Object {
+/// @brief An instance of a class.
+///
+/// Instance variables are stored in slots, in the order given by the
+/// object's shape.
+struct Object : MemoryTracked<MemoryKind::Object>, CycleNode {
   k_string identifier;
   k_string className;
-  std::unordered_map<k_string, k_value> instanceVariables;
+  Shape* shape = Shape::getRoot();
+  std::vector<k_value> slots;
 
   bool hasVariable(const k_string& name) const {
-    return instanceVariables.find(name) != instanceVariables.end();
+    return shape->findSlot(name) != nullptr;
+  }
+
+  k_value* findVariable(const k_string& name, const SlotCache& cache) {
+    auto index = cache.find(shape, name);
+    return index < 0 ? nullptr : &slots[index];
+  }
+
+  /// @brief Gets an instance variable, adding it if it is missing.
+  k_value& getVariable(const k_string& name) {
+    auto slot = shape->findSlot(name);
+    return slot ? slots[slot->index] : addVariable(name);
+  }
+
+  k_value& getVariable(const k_string& name, const SlotCache& cache) {
+    auto variable = findVariable(name, cache);
+    return variable ? *variable : addVariable(name);
+  }
+
+  void visitReferences(const CycleVisitor& visit) const override {
+    for (const auto& slot : slots) {
+      visit_references(slot, visit);
+    }
+  }
+
+  void clearReferences() override {
+    shape = Shape::getRoot();
+    slots.clear();
+  }
+
+ private:
+  k_value& addVariable(const k_string& name) {
+    shape = shape->addVariable(name);
+    slots.emplace_back();
+    return slots.back();
+  }
+};
+
+/// @brief Passes the value to the visitor if it can refer to other values.
+inline void visit_references(const k_value& value, const CycleVisitor& visit) {
+  switch (value.index()) {
+    case 4:  // k_list
+      visit(std::get<k_list>(value).get());
+      break;
+    case 5:  // k_hash
+      visit(std::get<k_hash>(value).get());
+      break;
+    case 6:  // k_object
+      visit(std::get<k_object>(value).get());
+      break;
+    default:
+      break;
+  }
+}
+
+/// @brief A dense matrix of doubles, stored row by row.
+struct Matrix : MemoryTracked<MemoryKind::Matrix> {
+  size_t rows = 0;
+  size_t cols = 0;
+  std::vector<double> cells;
+
+  Matrix() {}
+  Matrix(size_t rows, size_t cols, double fill = 0)
+      : rows(rows), cols(cols), cells(rows * cols, fill) {}
+
+  /// @brief Returns true when a rows-by-cols matrix has a cell count that
+  /// can be stored at all.
+  static bool canHold(size_t rows, size_t cols) {
+    return cols == 0 || rows <= std::vector<double>().max_size() / cols;
   }
+
+  double& at(size_t row, size_t col) { return cells[row * cols + col]; }
+  double at(size_t row, size_t col) const { return cells[row * cols + col]; }
 };
 
 struct LambdaRef {
@@ -149,17 +259,76 @@ std::size_t hash_hash(const k_hash& hash) {
   return seed;
 }
 
+std::size_t hash_matrix(const k_matrix& matrix) {
+  std::size_t seed = 0;
+  hash_combine(seed, matrix->rows);
+  hash_combine(seed, matrix->cols);
+  for (auto cell : matrix->cells) {
+    hash_combine(seed, std::hash<double>()(cell));
+  }
+  return seed;
+}
+
+/// @brief Returns an integer as a `k_int` when it fits, and as a `k_bigint`
+/// otherwise, so a `k_bigint` is always outside the range of a `k_int`.
+k_value make_integer(BigInt&& value) {
+  if (value.fitsInt64()) {
+    return static_cast<k_int>(value.toInt64());
+  }
+  return std::make_shared<BigInt>(std::move(value));
+}
+
+/// @brief Reads a `k_int` or a `k_bigint` as a `BigInt`.
+BigInt get_bigint(const k_value& value) {
+  if (std::holds_alternative<k_bigint>(value)) {
+    return *std::get<k_bigint>(value);
+  }
+  return BigInt(std::get<k_int>(value));
+}
+
+bool is_integer(const k_value& value) {
+  return std::holds_alternative<k_int>(value) ||
+         std::holds_alternative<k_bigint>(value);
+}
+
+/// @brief Compares two integers when either is a `k_bigint`. Returns false
+/// if either is not an integer.
+bool compare_bigint(const k_value& lhs, const k_value& rhs, int& order) {
+  if (!is_integer(lhs) || !is_integer(rhs)) {
+    return false;
+  }
+
+  // A k_bigint is always larger in magnitude than any k_int.
+  if (std::holds_alternative<k_int>(lhs)) {
+    order = std::get<k_bigint>(rhs)->isNegative() ? 1 : -1;
+  } else if (std::holds_alternative<k_int>(rhs)) {
+    order = std::get<k_bigint>(lhs)->isNegative() ? -1 : 1;
+  } else {
+    order = BigInt::compare(*std::get<k_bigint>(lhs),
+                            *std::get<k_bigint>(rhs));
+  }
+  return true;
+}
+
 std::size_t hash_object(const k_object& object) {
   auto seed = std::hash<k_string>()(object->className);
-  for (const auto& pair : object->instanceVariables) {
-    hash_combine(seed, std::hash<k_string>()(pair.first));
-    hash_combine(seed, std::hash<k_value>()(pair.second));
+  const auto& names = object->shape->getNames();
+  for (size_t i = 0; i < names.size(); ++i) {
+    hash_combine(seed, std::hash<k_string>()(names[i]));
+    hash_combine(seed, std::hash<k_value>()(object->slots[i]));
   }
   return seed;
 }
 
 struct ValueComparator {
   bool operator()(const k_value& lhs, const k_value& rhs) const {
+    int order = 0;
+    if (lhs.index() != rhs.index() || lhs.index() == 11) {
+      if (compare_bigint(lhs, rhs, order)) {
+        return order < 0;
+      }
+    }
+
     if (lhs.index() != rhs.index()) {
       return lhs.index() < rhs.index();
     }
@@ -235,6 +404,11 @@ k_value clone_value(const k_value& original) {
       return std::make_shared<Null>(*std::get<k_null>(original));
     case 9:  // k_class
       return std::make_shared<ClassRef>(*std::get<k_class>(original));
+    case 10:  // k_matrix
+      return std::make_shared<Matrix>(*std::get<k_matrix>(original));
+    case 11:  // k_bigint
+      // Integers are immutable, so the clone can share the digits.
+      return std::get<k_bigint>(original);
     default:
       throw std::runtime_error("Unsupported type for cloning");
   }
@@ -254,12 +428,28 @@ bool same_value(const k_value& v1, const k_value& v2) {
       return *std::get_if<bool>(&v1) == *std::get_if<bool>(&v2);
     case 3:  // k_string
       return *std::get_if<k_string>(&v1) == *std::get_if<k_string>(&v2);
+    case 10: {  // k_matrix
+      const auto& m1 = *std::get_if<k_matrix>(&v1);
+      const auto& m2 = *std::get_if<k_matrix>(&v2);
+      return m1->rows == m2->rows && m1->cols == m2->cols &&
+             m1->cells == m2->cells;
+    }
+    case 11:  // k_bigint
+      return BigInt::compare(*std::get<k_bigint>(v1),
+                             *std::get<k_bigint>(v2)) == 0;
     default:
       return std::hash<k_value>()(v1) == std::hash<k_value>()(v2);
   }
 }
 
 bool lt_value(const k_value& lhs, const k_value& rhs) {
+  int order = 0;
+  if (lhs.index() != rhs.index() || lhs.index() == 11) {
+    if (compare_bigint(lhs, rhs, order)) {
+      return order < 0;
+    }
+  }
+
   if (lhs.index() != rhs.index()) {
     return lhs.index() < rhs.index();
   }
@@ -288,6 +478,13 @@ bool lt_value(const k_value& lhs, const k_value& rhs) {
 }
 
 bool gt_value(const k_value& lhs, const k_value& rhs) {
+  int order = 0;
+  if (lhs.index() != rhs.index() || lhs.index() == 11) {
+    if (compare_bigint(lhs, rhs, order)) {
+      return order > 0;
+    }
+  }
+
   if (lhs.index() != rhs.index()) {
     return lhs.index() < rhs.index();
   }
@@ -316,23 +513,39 @@ bool gt_value(const k_value& lhs, const k_value& rhs) {
 }
 
 k_value sum_listvalue(k_list list) {
-  double sum = 0;
+  double doubleSum = 0;
   bool hasDouble = false;
+  // Integers add up exactly: in a k_int until that would overflow, and in
+  // a BigInt after.
+  k_int total = 0;
+  BigInt overflow;
 
   for (const auto& val : list->elements) {
     if (std::holds_alternative<k_int>(val)) {
-      sum += std::get<k_int>(val);
+      auto number = std::get<k_int>(val);
+      k_int next = 0;
+      if (Bits::addOverflow(total, number, next)) {
+        overflow = overflow + BigInt(total);
+        next = number;
+      }
+      total = next;
+    } else if (std::holds_alternative<k_bigint>(val)) {
+      overflow = overflow + *std::get<k_bigint>(val);
     } else if (std::holds_alternative<double>(val)) {
-      sum += std::get<double>(val);
+      doubleSum += std::get<double>(val);
       hasDouble = true;
     }
   }
 
+  if (overflow.isZero() && !hasDouble) {
+    return total;
+  }
+
+  auto integerSum = overflow + BigInt(total);
   if (hasDouble) {
-    return sum;
-  } else {
-    return static_cast<k_int>(sum);
+    return doubleSum + integerSum.toDouble();
   }
+  return make_integer(std::move(integerSum));
 }
 
 k_value min_listvalue(k_list list) {
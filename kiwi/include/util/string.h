@@ -6,6 +6,7 @@
 #include <cctype>
 #include <memory>
 #include <regex>
+#include "tracing/runtimestats.h"
 #include "typing/value.h"
 
 static const k_string base64_chars =
@@ -65,13 +66,21 @@ class String {
     return static_cast<k_int>(count);
   }
 
+  /// @brief Compiles a regular expression.
+  /// @param pattern The regular expression.
+  /// @return A compiled regular expression.
+  static std::regex compileRegex(const k_string& pattern) {
+    RuntimeStats::increment(RuntimeCounter::RegexCompiles);
+    return std::regex(pattern);
+  }
+
   /// @brief Searches for the first occurrence of a pattern described by a regex and returns the substring.
   /// @param text The string to check.
   /// @param pattern The regular expression.
   /// @return A string.
   static k_string find(const k_string& text, const k_string& pattern) {
     std::cout << "find(\"" << text << "\", '" << pattern << "')" << std::endl;
-    std::regex reg(pattern);
+    auto reg = compileRegex(pattern);
     std::smatch match;
 
     if (std::regex_search(text, match, reg) && match.size() > 0) {
@@ -113,7 +122,7 @@ class String {
   /// @param pattern The regular expression.
   /// @return A list.
   static k_list match(const k_string& text, const k_string& pattern) {
-    std::regex reg(pattern);
+    auto reg = compileRegex(pattern);
     std::smatch match;
     std::vector<k_value> results;
 
@@ -131,7 +140,7 @@ class String {
   /// @param pattern The regular expression.
   /// @return A boolean.
   static bool matches(const k_string& text, const k_string& pattern) {
-    std::regex reg(pattern);
+    auto reg = compileRegex(pattern);
     return std::regex_match(text, reg);
   }
 
@@ -140,7 +149,7 @@ class String {
   /// @param pattern The regular expression.
   /// @return A boolean.
   static bool matchesAll(const k_string& text, const k_string& pattern) {
-    std::regex reg(pattern);
+    auto reg = compileRegex(pattern);
     auto words_begin = std::sregex_iterator(text.begin(), text.end(), reg);
     auto words_end = std::sregex_iterator();
 
@@ -180,7 +189,7 @@ class String {
     if (text.empty()) {
       return text;
     }
-    std::regex reg(pattern);
+    auto reg = compileRegex(pattern);
     return std::regex_replace(text, reg, replacement);
   }
 
@@ -189,7 +198,7 @@ class String {
   /// @param pattern The regular expression.
   /// @return A list.
   static k_list scan(const k_string& text, const k_string& pattern) {
-    std::regex reg(pattern);
+    auto reg = compileRegex(pattern);
     std::sregex_iterator begin(text.begin(), text.end(), reg);
     std::sregex_iterator end;
 
@@ -226,7 +235,7 @@ class String {
   static std::vector<k_string> rsplit(const k_string& text,
                                       const k_string& pattern,
                                       k_int limit = -1) {
-    std::regex reg(pattern);
+    auto reg = compileRegex(pattern);
     std::sregex_token_iterator iter(text.begin(), text.end(), reg, -1);
     std::sregex_token_iterator end;
 
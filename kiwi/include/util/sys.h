@@ -2,8 +2,11 @@
 #define KIWI_SYSTEM_SYS_H
 
 #include <array>
+#include <cstdint>
 #include <cstdlib>
 #include <cstdio>
+#include <exception>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
@@ -11,11 +14,18 @@
 #ifdef _WIN64
 #include <WinSock2.h>
 #include "Windows.h"
+#include <psapi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #else
+#include <pthread.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <sys/mman.h>
+#include <ucontext.h>
+#endif
 #include "typing/value.h"
 
 class Sys {
@@ -66,6 +76,126 @@ class Sys {
     return geteuid();
 #endif
   }
+
+  /// @brief Gets the peak resident set size of this process.
+  /// @return The peak resident set size in kilobytes.
+  static k_int getPeakResidentKilobytes() {
+#ifdef _WIN64
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                              sizeof(counters))) {
+      return 0;
+    }
+    return static_cast<k_int>(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+      return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<k_int>(usage.ru_maxrss / 1024);
+#else
+    return static_cast<k_int>(usage.ru_maxrss);
+#endif
+#endif
+  }
+
+  /// @brief Runs a function on a stack of the given size and returns its
+  /// result.
+  ///
+  /// On Linux the calling thread switches to a freshly mapped stack and
+  /// back, so neither the process stack limit, which child processes
+  /// inherit, nor the thread count changes. A second thread would make
+  /// libstdc++ update every shared_ptr count atomically. Elsewhere the
+  /// function runs on the current stack.
+  static int runWithStack(size_t size, const std::function<int()>& function) {
+#ifdef __linux__
+    auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+      return function();
+    }
+
+    // The lowest page stays unmapped, so an overrun faults instead of
+    // writing past the stack.
+    auto low = reinterpret_cast<uintptr_t>(memory);
+    mprotect(memory, page, PROT_NONE);
+
+    StackCall call{&function, 0, nullptr};
+    ucontext_t caller;
+    ucontext_t callee;
+    getcontext(&callee);
+    callee.uc_stack.ss_sp = memory;
+    callee.uc_stack.ss_size = size;
+    callee.uc_link = &caller;
+    makecontext(&callee, runStackCall, 0);
+
+    pendingCall = &call;
+    switchedStackLow = low + page;
+    swapcontext(&caller, &callee);
+    switchedStackLow = 0;
+    munmap(memory, size);
+
+    if (call.error) {
+      std::rethrow_exception(call.error);
+    }
+    return call.result;
+#else
+    return function();
+#endif
+  }
+
+  /// @brief Gets the lowest address of the calling thread's stack.
+  /// @return The address, or zero if it cannot be determined.
+  static uintptr_t getStackLowAddress() {
+    if (switchedStackLow != 0) {
+      return switchedStackLow;
+    }
+
+#ifdef _WIN64
+    ULONG_PTR low = 0;
+    ULONG_PTR high = 0;
+    GetCurrentThreadStackLimits(&low, &high);
+    return static_cast<uintptr_t>(low);
+#elif defined(__APPLE__)
+    auto self = pthread_self();
+    auto high = reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np(self));
+    return high - pthread_get_stacksize_np(self);
+#else
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) != 0) {
+      return 0;
+    }
+
+    void* low = nullptr;
+    size_t size = 0;
+    pthread_attr_getstack(&attributes, &low, &size);
+    pthread_attr_destroy(&attributes);
+    return reinterpret_cast<uintptr_t>(low);
+#endif
+  }
+
+ private:
+  struct StackCall {
+    const std::function<int()>* function;
+    int result;
+    std::exception_ptr error;
+  };
+
+  inline static thread_local StackCall* pendingCall = nullptr;
+  inline static thread_local uintptr_t switchedStackLow = 0;
+
+  /// @brief Runs the pending call on the switched stack. Exceptions are
+  /// carried back to the caller, since they cannot unwind past the switch.
+  static void runStackCall() {
+    auto call = pendingCall;
+    try {
+      call->result = (*call->function)();
+    } catch (...) {
+      call->error = std::current_exception();
+    }
+  }
 };
 
 #endif